@@ -0,0 +1,303 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/************************************************************************
+** Measures the cost of cross thread calls: time per call, and heap
+** allocations per call. Every allocation made by the process is counted,
+** through replacements of the global operator new and delete. Then
+** compares the round trip latency of syncCall across pickup policies.
+** 
+** Usage: ThreadSynchBenchmark [calls]
+*/
+
+// STL headers
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+// ThreadSynch Headers
+#include "../ThreadSynch/ThreadSynch.h"
+#include "../ThreadSynch/ManualPickupPolicy.h"
+#include "../ThreadSynch/BusyPollPickupPolicy.h"
+#ifdef _WIN32
+#include "../ThreadSynch/APCPickupPolicy.h"
+typedef ThreadSynch::APCPickupPolicy BenchmarkPickupPolicy;
+#else
+#include "../ThreadSynch/PosixAPCPickupPolicy.h"
+typedef ThreadSynch::PosixAPCPickupPolicy BenchmarkPickupPolicy;
+#endif
+
+typedef ThreadSynch::CallScheduler<BenchmarkPickupPolicy> Scheduler;
+typedef ThreadSynch::CallScheduler<ThreadSynch::ManualPickupPolicy> ManualScheduler;
+typedef ThreadSynch::CallScheduler<ThreadSynch::BusyPollPickupPolicy> PollingScheduler;
+
+/************************************************************************
+** Allocation counting
+*/
+
+std::atomic<unsigned long long> g_allocationCount(0);
+
+void* operator new(size_t size)
+{
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) throw()
+{
+    std::free(p);
+}
+
+/************************************************************************
+** Target thread
+*/
+
+std::atomic<bool> g_bStop(false);
+std::atomic<ThreadSynch::ThreadId> g_targetThreadId(0);
+
+void targetThread()
+{
+#ifdef _WIN32
+    g_targetThreadId = GetCurrentThreadId();
+    while(!g_bStop)
+    {
+        SleepEx(10, TRUE);
+    }
+#else
+    BenchmarkPickupPolicy::registerCurrentThread();
+    g_targetThreadId = ThreadSynch::details::getCurrentThreadId();
+    while(!g_bStop)
+    {
+        BenchmarkPickupPolicy::alertableWait(10);
+    }
+    BenchmarkPickupPolicy::unregisterCurrentThread();
+#endif
+}
+
+std::atomic<ThreadSynch::ThreadId> g_pumpingThreadId(0);
+
+void pumpingThread()
+{
+    g_pumpingThreadId = ThreadSynch::details::getCurrentThreadId();
+    while(!g_bStop)
+    {
+        ManualScheduler::getInstance()->pump(10, 0);
+    }
+}
+
+std::atomic<ThreadSynch::ThreadId> g_pollingThreadId(0);
+
+// A polling thread which shares its core has to yield to the caller it waits for
+size_t g_emptyPollsBeforeYield = std::thread::hardware_concurrency() > 1 ? 0 : 64;
+
+void pollingThread()
+{
+    g_pollingThreadId = ThreadSynch::details::getCurrentThreadId();
+    ThreadSynch::BusyPollPickupPolicy::run(PollingScheduler::getInstance(), g_bStop, g_emptyPollsBeforeYield);
+}
+
+ThreadSynch::ThreadId waitForThreadId(const std::atomic<ThreadSynch::ThreadId>& threadId)
+{
+    while(threadId == 0)
+    {
+        std::this_thread::yield();
+    }
+    return threadId;
+}
+
+int work(int input)
+{
+    return input + 1;
+}
+
+/************************************************************************
+** Measurements
+*/
+
+struct Result
+{
+    double nsPerCall;
+    double allocationsPerCall;
+};
+
+void report(const char* name, const Result& result)
+{
+    std::printf("%-32s %12.1f ns/call %10.2f allocations/call\n", name, result.nsPerCall, result.allocationsPerCall);
+}
+
+template<class F>
+Result measure(F run, int calls)
+{
+    // Warm up the frame pools, the mailbox and the pickup policy
+    run(calls / 10 + 1);
+
+    unsigned long long allocations = g_allocationCount.load();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run(calls);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    allocations = g_allocationCount.load() - allocations;
+
+    Result result;
+    result.nsPerCall = std::chrono::duration<double, std::nano>(end - start).count() / calls;
+    result.allocationsPerCall = static_cast<double>(allocations) / calls;
+    return result;
+}
+
+void runSyncCalls(const ThreadSynch::ThreadEndpoint& target, int calls)
+{
+    Scheduler* scheduler = Scheduler::getInstance();
+    for(int i = 0; i < calls; ++i)
+    {
+        scheduler->syncCall<int>(target, boost::function<int()>(boost::bind(work, i)), INFINITE);
+    }
+}
+
+void runVariadicSyncCalls(const ThreadSynch::ThreadEndpoint& target, int calls)
+{
+    Scheduler* scheduler = Scheduler::getInstance();
+    for(int i = 0; i < calls; ++i)
+    {
+        scheduler->syncCall(target, work, i);
+    }
+}
+
+void runAsyncCalls(const ThreadSynch::ThreadEndpoint& target, int calls)
+{
+    Scheduler* scheduler = Scheduler::getInstance();
+    const int batchSize = 64;
+    std::vector<ThreadSynch::Future<int>> futures;
+    futures.reserve(batchSize);
+    for(int i = 0; i < calls; i += batchSize)
+    {
+        for(int j = 0; j < batchSize; ++j)
+        {
+            futures.push_back(scheduler->asyncCall(target, boost::function<int()>(boost::bind(work, i + j))));
+        }
+        for(size_t j = 0; j < futures.size(); ++j)
+        {
+            futures[j].wait(INFINITE);
+        }
+        futures.clear();
+    }
+}
+
+void runAsyncCallBatches(const ThreadSynch::ThreadEndpoint& target, int calls)
+{
+    Scheduler* scheduler = Scheduler::getInstance();
+    const int batchSize = 64;
+    std::vector<boost::function<int()>> callbacks;
+    callbacks.reserve(batchSize);
+    for(int i = 0; i < calls; i += batchSize)
+    {
+        for(int j = 0; j < batchSize; ++j)
+        {
+            callbacks.push_back(boost::bind(work, i + j));
+        }
+        scheduler->asyncCallBatch(target, callbacks).wait(INFINITE);
+        callbacks.clear();
+    }
+}
+
+/************************************************************************
+** Latency
+*/
+
+template<class SchedulerType>
+void reportLatency(const char* name, ThreadSynch::ThreadId dwTargetThreadId, int calls)
+{
+    SchedulerType* scheduler = SchedulerType::getInstance();
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(dwTargetThreadId);
+
+    // Warm up, then time every round trip on its own
+    for(int i = 0; i < calls / 10 + 1; ++i)
+    {
+        scheduler->syncCall(endpoint, work, i);
+    }
+    std::vector<std::chrono::steady_clock::duration> samples;
+    samples.reserve(calls);
+    for(int i = 0; i < calls; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        scheduler->syncCall(endpoint, work, i);
+        samples.push_back(std::chrono::steady_clock::now() - start);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    double percentiles[] = { 0.5, 0.99, 0.999 };
+    double microseconds[3];
+    for(size_t i = 0; i < 3; ++i)
+    {
+        size_t index = std::min(samples.size() - 1, static_cast<size_t>(samples.size() * percentiles[i]));
+        microseconds[i] = std::chrono::duration<double, std::micro>(samples[index]).count();
+    }
+    std::printf("%-32s %9.2f us p50 %9.2f us p99 %9.2f us p99.9\n", name, microseconds[0], microseconds[1], microseconds[2]);
+}
+
+int main(int argc, char* argv[])
+{
+    int calls = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    std::thread target(targetThread);
+    while(g_targetThreadId == 0)
+    {
+        std::this_thread::yield();
+    }
+
+    Scheduler* scheduler = Scheduler::getInstance();
+    ThreadSynch::ThreadId dwTargetThreadId = g_targetThreadId;
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(dwTargetThreadId);
+
+    std::printf("%d calls per measurement\n", calls);
+    report("syncCall (thread id)", measure(boost::bind(runSyncCalls, ThreadSynch::ThreadEndpoint(dwTargetThreadId), _1), calls));
+    report("syncCall (endpoint)", measure(boost::bind(runSyncCalls, endpoint, _1), calls));
+    report("syncCall (endpoint, variadic)", measure(boost::bind(runVariadicSyncCalls, endpoint, _1), calls));
+    report("asyncCall, batches of 64", measure(boost::bind(runAsyncCalls, endpoint, _1), calls));
+    report("asyncCallBatch, batches of 64", measure(boost::bind(runAsyncCallBatches, endpoint, _1), calls));
+
+    // The same round trip, picked up by a thread blocked in the policy's wait, parked in a pump, or polling.
+    // The polling thread only starts once the others are measured, as it would compete with them for a core.
+    std::thread pumping(pumpingThread);
+    std::printf("\nsyncCall round trip latency, %d calls%s\n", calls, g_emptyPollsBeforeYield != 0 ? " (single core: the polling thread yields)" : "");
+#ifdef _WIN32
+    reportLatency<Scheduler>("APCPickupPolicy", dwTargetThreadId, calls);
+#else
+    reportLatency<Scheduler>("PosixAPCPickupPolicy", dwTargetThreadId, calls);
+#endif
+    reportLatency<ManualScheduler>("ManualPickupPolicy (pump)", waitForThreadId(g_pumpingThreadId), calls);
+    std::thread polling(pollingThread);
+    reportLatency<PollingScheduler>("BusyPollPickupPolicy", waitForThreadId(g_pollingThreadId), calls);
+
+    g_bStop = true;
+    target.join();
+    pumping.join();
+    polling.join();
+    return 0;
+}
\ No newline at end of file
@@ -23,7 +23,7 @@ namespace ThreadSynch
 	class APCPickupPolicy : public PickupPolicyProvider
 	{
 	public:
-		static void scheduleThreadCallback(DWORD dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+		static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
 		{
 			HANDLE hThread = OpenThread(THREAD_SET_CONTEXT, FALSE, dwThreadId);
 			if(hThread == NULL)
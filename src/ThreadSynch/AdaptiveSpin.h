@@ -0,0 +1,98 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+
+#pragma once
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        /*!@class AdaptiveSpin
+        ** @brief Decides how long a synchronous caller spins on its call's completion before parking,
+        **        from the durations of recent calls to the same thread.
+        ** @remark
+        **   Parking and waking a thread costs tens of microseconds, which dwarfs a call that completes
+        **   in a few. So the caller spins, for twice the recent average call duration, and parks only 
+        **   if the call takes longer than that. Threads whose calls usually outlast 
+        **   THREADSYNCH_MAX_SPIN_MICROSECONDS aren't spun on at all. The average is a running one, 
+        **   weighted 1/8 towards the latest call, and updated without locks. Racing updates may lose a
+        **   sample, which is harmless.
+        **
+        **   Spinning only pays off when the target thread can run meanwhile, so it is disabled on 
+        **   single processor machines, and when THREADSYNCH_MAX_SPIN_MICROSECONDS is 0.
+        */
+        class AdaptiveSpin : private boost::noncopyable
+        {
+        public:
+            AdaptiveSpin()
+                : m_averageNanoseconds(0)
+            {}
+
+            /*!
+            ** @return Whether or not callers should spin at all. Callers which don't needn't time their calls.
+            */
+            static BOOL isEnabled()
+            {
+                static const BOOL bEnabled = THREADSYNCH_MAX_SPIN_MICROSECONDS > 0 && std::thread::hardware_concurrency() > 1;
+                return bEnabled;
+            }
+
+            /*!
+            ** @return How long the next caller should spin. Until a call has been timed, that's the maximum.
+            */
+            std::chrono::steady_clock::duration getSpin() const
+            {
+                const uint32_t maxSpinNanoseconds = THREADSYNCH_MAX_SPIN_MICROSECONDS * 1000;
+                uint32_t averageNanoseconds = m_averageNanoseconds.load(std::memory_order_relaxed);
+                if(averageNanoseconds == 0)
+                {
+                    return std::chrono::microseconds(THREADSYNCH_MAX_SPIN_MICROSECONDS);
+                }
+                if(averageNanoseconds > maxSpinNanoseconds)
+                {
+                    return std::chrono::steady_clock::duration::zero();
+                }
+                return std::chrono::nanoseconds(std::min(2 * averageNanoseconds, maxSpinNanoseconds));
+            }
+
+            /*!
+            ** @brief Folds the duration of a completed call, from scheduling to completion, into the average.
+            */
+            void record(std::chrono::steady_clock::duration elapsed)
+            {
+                // Anything past a second is simply long, and keeping it there keeps the arithmetic in range
+                int64_t sample = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+                sample = std::max<int64_t>(1, std::min<int64_t>(sample, 1000000000));
+
+                int64_t average = m_averageNanoseconds.load(std::memory_order_relaxed);
+                if(average == 0)
+                {
+                    average = sample;
+                }
+                else
+                {
+                    average += (sample - average) / 8;
+                }
+                m_averageNanoseconds.store(static_cast<uint32_t>(std::max<int64_t>(1, average)), std::memory_order_relaxed);
+            }
+
+        private:
+            // The running average call duration in nanoseconds, or 0 if no call has been timed yet
+            std::atomic<uint32_t> m_averageNanoseconds;
+        };
+    }
+}
\ No newline at end of file
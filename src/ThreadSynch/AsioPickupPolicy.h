@@ -0,0 +1,135 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/post.hpp>
+#include "PickupPolicyProvider.h"
+
+namespace ThreadSynch
+{
+    /*!@class AsioPickupPolicy
+    ** @brief A pickup policy which delivers calls into a Boost.Asio io_context, or a strand of one.
+    ** @remark
+    **   A target is registered with registerTarget, which hands back a ThreadId standing in for it. Calls
+    **   are scheduled to that id, or to an endpoint resolved from it, like to any thread. They run in
+    **   handlers posted to the target, on whichever thread runs the io_context, and their return values,
+    **   exceptions and Futures behave exactly as with the other policies.
+    **
+    **   The scheduler only notifies a target when its mailbox goes from empty to non-empty, so a burst of
+    **   calls costs a single post, and is run by a single handler.
+    **
+    **   The calls of one target must never run concurrently, so an io_context is wrapped in a strand of
+    **   its own. A thread running the target's handlers must not make synchronous calls to the target, as
+    **   it would wait for itself.
+    */
+    class AsioPickupPolicy : public PickupPolicyProvider
+    {
+    public:
+        static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+        {
+            boost::shared_ptr<POSTFUNCTION> pPost = findTarget(dwThreadId);
+            if(!pPost)
+            {
+                throw PickupSchedulingFailedException();
+            }
+            (*pPost)(pCallbackFunction, ulpFunctionParameter);
+        }
+
+        /*!
+        ** @brief Makes an io_context a valid target for scheduled calls. The calls run in a strand.
+        ** @param[in] ioContext the io_context, which must outlive the registration.
+        ** @return The id to schedule calls to. It never collides with the id of a thread.
+        */
+        static ThreadId registerTarget(boost::asio::io_context& ioContext)
+        {
+            return registerTarget(boost::asio::make_strand(ioContext));
+        }
+
+        /*!
+        ** @brief Makes a strand a valid target for scheduled calls.
+        ** @param[in] strand the strand, whose execution context must outlive the registration.
+        ** @return The id to schedule calls to. It never collides with the id of a thread.
+        */
+        template<class Executor>
+        static ThreadId registerTarget(const boost::asio::strand<Executor>& strand)
+        {
+            boost::shared_ptr<POSTFUNCTION> pPost(new POSTFUNCTION(
+                [strand](PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+                {
+                    boost::asio::post(strand, [pCallbackFunction, ulpFunctionParameter]() { pCallbackFunction(ulpFunctionParameter); });
+                }));
+
+            std::lock_guard<std::mutex> lock(registryMutex());
+            ThreadId dwTargetId = nextTargetId();
+            registry()[dwTargetId] = pPost;
+            return dwTargetId;
+        }
+
+        /*!
+        ** @brief Removes a target from the set of valid targets. Handlers already posted still run.
+        */
+        static void unregisterTarget(ThreadId dwTargetId)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry().erase(dwTargetId);
+        }
+
+    private:
+        typedef boost::function<void (PCALLBACK, ULONG_PTR)> POSTFUNCTION;
+        typedef std::map<ThreadId, boost::shared_ptr<POSTFUNCTION>> TARGETMAP;
+
+        static boost::shared_ptr<POSTFUNCTION> findTarget(ThreadId dwTargetId)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            TARGETMAP::iterator targetIter = registry().find(dwTargetId);
+            if(targetIter == registry().end())
+            {
+                return boost::shared_ptr<POSTFUNCTION>();
+            }
+            return targetIter->second;
+        }
+
+        /*!
+        ** @return An id no thread will ever have. Linux thread ids are positive, and Windows thread ids
+        **   are multiples of four, so the ids count down from -1 in steps of four. Ids are not reused,
+        **   as the scheduler keeps a target's mailbox for its lifetime. Called with the registry locked.
+        */
+        static ThreadId nextTargetId()
+        {
+            static ThreadId dwNextTargetId = static_cast<ThreadId>(-1);
+            ThreadId dwTargetId = dwNextTargetId;
+            dwNextTargetId -= 4;
+            return dwTargetId;
+        }
+
+        // The registry is intentionally never destroyed, as registered targets may well outlive
+        // static destruction.
+        static TARGETMAP& registry()
+        {
+            static TARGETMAP* pTargets = new TARGETMAP();
+            return *pTargets;
+        }
+
+        static std::mutex& registryMutex()
+        {
+            static std::mutex* pMutex = new std::mutex();
+            return *pMutex;
+        }
+    };
+}
\ No newline at end of file
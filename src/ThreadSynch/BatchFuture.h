@@ -0,0 +1,234 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include "CallHandler.h"
+#include "Future_Impl.h"
+
+namespace ThreadSynch
+{
+    /*!@class BatchFuture_Impl
+    ** @brief The state shared by copies of a BatchFuture.
+    */
+    template<typename T>
+    class BatchFuture_Impl : private boost::noncopyable
+    {
+    public:
+        typedef std::vector<boost::intrusive_ptr<CallHandler>> CALLHANDLERS;
+
+        /*!
+        ** @param[in] callHandlers the calls of the batch, in the order they were scheduled. Swapped in, leaving the vector empty.
+        ** @param[in] pBatch the batch the calls have joined.
+        */
+        BatchFuture_Impl(CALLHANDLERS& callHandlers, const boost::intrusive_ptr<details::CallBatch>& pBatch)
+            : m_pBatch(pBatch),
+              m_valuesTaken(callHandlers.size())
+        {
+            m_callHandlers.swap(callHandlers);
+        }
+
+        ~BatchFuture_Impl()
+        {
+            try
+            {
+                abort();
+            }
+            catch(...)
+            { /* No exceptions may leave the DTOR */ }
+        }
+
+        size_t size() const
+        {
+            return m_callHandlers.size();
+        }
+
+        ASYNCH_CALL_STATUS wait(DWORD dwTimeout) const
+        {
+            return m_pBatch->waitForCompletion(dwTimeout) ? ASYNCH_CALL_COMPLETE : ASYNCH_CALL_PENDING;
+        }
+
+        ASYNCH_CALL_STATUS abort() const
+        {
+            // Cancel from the back, as the target thread claims calls from the front. Calls which have already 
+            // been claimed are run to completion, so wait for those.
+            for(typename CALLHANDLERS::const_reverse_iterator it = m_callHandlers.rbegin(); it != m_callHandlers.rend(); ++it)
+            {
+                (*it)->cancel();
+            }
+            m_pBatch->waitForCompletion(INFINITE);
+
+            // Rethrow the exception of the first call which threw one, if any
+            BOOL bAborted = FALSE;
+            for(typename CALLHANDLERS::const_iterator it = m_callHandlers.begin(); it != m_callHandlers.end(); ++it)
+            {
+                if((*it)->isCancelled())
+                {
+                    bAborted = TRUE;
+                }
+                else if((*it)->caughtException())
+                {
+                    (*it)->rethrowException();
+                }
+            }
+            return bAborted ? ASYNCH_CALL_ABORTED : ASYNCH_CALL_COMPLETE;
+        }
+
+        T getValue(size_t index) const
+        {
+            CallHandler* pCallHandler = getCompletedCall(index);
+            if(m_valuesTaken[index].load(std::memory_order_acquire))
+            {
+                throw FutureValueTaken();
+            }
+            return copyReturnValue(pCallHandler, boost::is_void<T>());
+        }
+
+        T take(size_t index)
+        {
+            CallHandler* pCallHandler = getCompletedCall(index);
+            if(m_valuesTaken[index].exchange(TRUE, std::memory_order_acq_rel))
+            {
+                throw FutureValueTaken();
+            }
+            return moveReturnValue(pCallHandler, boost::is_void<T>());
+        }
+
+    private:
+        // Finds a call which has completed, rethrowing its exception if it threw one
+        CallHandler* getCompletedCall(size_t index) const
+        {
+            const boost::intrusive_ptr<CallHandler>& pCallHandler = m_callHandlers.at(index);
+            if(!pCallHandler->isCompleted())
+            {
+                throw FutureValuePending();
+            }
+            if(pCallHandler->caughtException())
+            {
+                pCallHandler->rethrowException();
+            }
+            return pCallHandler.get();
+        }
+
+        static T copyReturnValue(CallHandler* pCallHandler, boost::false_type)
+        {
+            return pCallHandler->getReturnValue<T>();
+        }
+
+        static T moveReturnValue(CallHandler* pCallHandler, boost::false_type)
+        {
+            return std::move(pCallHandler->getReturnValue<T>());
+        }
+
+        // Calls without a return value have nothing to hand out
+        static void copyReturnValue(CallHandler*, boost::true_type)
+        {}
+
+        static void moveReturnValue(CallHandler*, boost::true_type)
+        {}
+
+        CALLHANDLERS m_callHandlers;
+        boost::intrusive_ptr<details::CallBatch> m_pBatch;
+
+        /*!
+        ** One flag per call, set once its value has been moved out by take
+        */
+        std::vector<std::atomic<BOOL>> m_valuesTaken;
+    };
+
+    /*!@class BatchFuture
+    ** @brief Holds the results of a batch of calls, as scheduled by CallScheduler::asyncCallBatch.
+    ** @remark
+    **   The whole batch is waited for, or aborted, as one. Completion is tracked by a single counter, so 
+    **   waiting for a batch costs the same no matter how many calls it holds. Values are fetched per call, by
+    **   the call's position in the batch.
+    */
+    template<typename T>
+    class BatchFuture
+    {
+    public:
+        /*!
+        ** @throw std::bad_alloc The inner BatchFuture_Impl could not be allocated.
+        */
+        BatchFuture(typename BatchFuture_Impl<T>::CALLHANDLERS& callHandlers, const boost::intrusive_ptr<details::CallBatch>& pBatch)
+            : m_pFutureImpl(boost::make_shared<BatchFuture_Impl<T>>(callHandlers, pBatch))
+        {}
+
+        BatchFuture(const BatchFuture& other)
+            : m_pFutureImpl(other.m_pFutureImpl)
+        {}
+
+        BatchFuture(BatchFuture&& other)
+            : m_pFutureImpl(std::move(other.m_pFutureImpl))
+        {}
+
+        /*! 
+        ** @return the number of calls in the batch.
+        */
+        size_t size() const
+        {
+            return m_pFutureImpl->size();
+        }
+
+        /*! 
+        ** @brief Waits for every call in the batch to complete, or to be aborted.
+        ** @param[in] dwTimeout number of milliseconds to wait before terminating.
+        ** @return ASYNCH_CALL_COMPLETE once all calls are done, or ASYNCH_CALL_PENDING on timeout.
+        */
+        ASYNCH_CALL_STATUS wait(DWORD dwTimeout) const // Never throws
+        {
+            return m_pFutureImpl->wait(dwTimeout);
+        }
+
+        /*! 
+        ** @brief Aborts the calls which have not yet started, and waits for the ones that have to complete.
+        ** @return ASYNCH_CALL_ABORTED if any call was aborted, or ASYNCH_CALL_COMPLETE if all calls ran.
+        ** @throw ... The exception of the first call, in batch order, which threw an expected exception.
+        */
+        ASYNCH_CALL_STATUS abort() const // May throw
+        {
+            return m_pFutureImpl->abort();
+        }
+
+        /*! 
+        ** @param[in] index the position of the call in the batch.
+        ** @return a copy of the value returned by the call.
+        ** @throw FutureValuePending The call is still being computed, or has been aborted.
+        ** @throw FutureValueTaken The value has been moved out by take.
+        ** @throw ... The exception thrown by the call, if any.
+        */
+        T getValue(size_t index) const // May throw
+        {
+            return m_pFutureImpl->getValue(index);
+        }
+
+        /*! 
+        ** @brief Moves the value returned by a call out of the batch.
+        ** @param[in] index the position of the call in the batch.
+        ** @throw FutureValuePending The call is still being computed, or has been aborted.
+        ** @throw FutureValueTaken The value has already been taken, through this BatchFuture or a copy of it.
+        ** @throw ... The exception thrown by the call, if any.
+        */
+        T take(size_t index) // May throw
+        {
+            return m_pFutureImpl->take(index);
+        }
+
+    private:
+        boost::shared_ptr<BatchFuture_Impl<T>> m_pFutureImpl;
+        BatchFuture& operator=(const BatchFuture& other); // Not implemented
+    };
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include <boost/bind/bind.hpp>
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        template<size_t... Indices>
+        struct IndexSequence
+        {};
+
+        template<size_t N, size_t... Indices>
+        struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Indices...>
+        {};
+
+        template<size_t... Indices>
+        struct MakeIndexSequence<0, Indices...>
+        {
+            typedef IndexSequence<Indices...> type;
+        };
+
+        /*!
+        ** @brief The type a callable is stored as. Pointers to members are wrapped by std::mem_fn, so that
+        **        they can be called with the object pointer as their first argument.
+        */
+        template<class F, class DecayedF = typename std::decay<F>::type, bool bMemberPointer = std::is_member_pointer<DecayedF>::value>
+        struct StoredCallable
+        {
+            typedef DecayedF type;
+
+            static DecayedF&& wrap(DecayedF&& functor) { return std::move(functor); }
+            static const DecayedF& wrap(const DecayedF& functor) { return functor; }
+        };
+
+        template<class F, class DecayedF>
+        struct StoredCallable<F, DecayedF, true>
+        {
+            typedef decltype(std::mem_fn(std::declval<DecayedF>())) type;
+
+            static type wrap(DecayedF member) { return std::mem_fn(member); }
+        };
+
+        template<class F, class... Args>
+        struct BoundCallDetector
+        {
+            template<class R>
+            struct Result
+            {
+                typedef typename std::decay<R>::type type;
+            };
+
+            struct NoResult
+            {};
+
+            template<class G>
+            static Result<decltype(std::declval<G&>()(std::declval<typename std::decay<Args>::type>()...))> test(int);
+
+            template<class G>
+            static NoResult test(...);
+        };
+
+        /*!
+        ** @brief Whether F is a boost::bind or std::bind expression. These accept, and ignore, any arguments.
+        */
+        template<class F, class DecayedF = typename std::decay<F>::type>
+        struct IsBindExpression : std::integral_constant<bool, boost::is_bind_expression<DecayedF>::value != 0 || std::is_bind_expression<DecayedF>::value>
+        {};
+
+        /*!
+        ** @brief Has a nested type, the decayed result of calling F with Args, only if the call is well formed.
+        **        Used to take the variadic call overloads out of overload resolution for anything else.
+        ** @remark Bind expressions are only well formed without arguments, so that a trailing timeout is never
+        **         mistaken for one.
+        */
+        template<class F, class... Args>
+        struct BoundCallResult : std::conditional<IsBindExpression<F>::value && sizeof...(Args) != 0,
+                                                  typename BoundCallDetector<F, Args...>::NoResult,
+                                                  decltype(BoundCallDetector<F, Args...>::template test<typename StoredCallable<F>::type>(0))>::type
+        {};
+
+        /*!@class BoundCall
+        ** @brief A callable together with the arguments it is to be called with.
+        ** @remark
+        **   The callable and the arguments are decay copied into the call exactly once, and moved when the
+        **   arguments are rvalues. When the call is made, the arguments are passed on as rvalues, so they can
+        **   be moved on into by-value parameters. Like with std::thread, use std::ref to pass a reference.
+        **   A call is made once, at most.
+        */
+        template<class F, class... Args>
+        class BoundCall
+        {
+        public:
+            typedef typename BoundCallResult<F, Args...>::type ResultType;
+
+            template<class G, class... A>
+            explicit BoundCall(G&& functor, A&&... arguments)
+                : m_functor(StoredCallable<F>::wrap(std::forward<G>(functor))),
+                  m_arguments(std::forward<A>(arguments)...)
+            {}
+
+            ResultType operator()()
+            {
+                return call(typename MakeIndexSequence<sizeof...(Args)>::type());
+            }
+
+        private:
+            template<size_t... Indices>
+            ResultType call(IndexSequence<Indices...>)
+            {
+                return m_functor(std::move(std::get<Indices>(m_arguments))...);
+            }
+
+            typename StoredCallable<F>::type m_functor;
+            std::tuple<typename std::decay<Args>::type...> m_arguments;
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include "PickupPolicyProvider.h"
+
+namespace ThreadSynch
+{
+    /*!@class BusyPollPickupPolicy
+    ** @brief A pickup policy for latency critical threads, which spin on their mailbox rather than sleep.
+    ** @remark
+    **   The scheduler never signals the target thread. Producers only publish their calls to its mailbox,
+    **   and the thread finds them by polling, either in its own loop with scheduler->poll(maxCalls), or
+    **   in run. Neither side makes a system call.
+    **
+    **   Meant for threads pinned to cores of their own. On a shared core, a polling thread takes time 
+    **   from the producers it is waiting for, so have it yield now and then.
+    */
+    class BusyPollPickupPolicy : public PickupPolicyProvider
+    {
+    public:
+        static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+        {
+            /* The thread finds its calls the next time it polls */
+        }
+
+        /*!
+        ** @brief Polls the calling thread's mailbox, and runs the calls found, until told to stop.
+        ** @param[in] pScheduler the scheduler the calls are made through.
+        ** @param[in] bStop set, from any thread, to make run return. Checked between polls.
+        ** @param[in] emptyPollsBeforeYield the number of empty polls in a row after which the thread 
+        **            yields its core, or 0 to never yield. Every empty poll pauses the core briefly.
+        */
+        template<class Scheduler>
+        static void run(Scheduler* pScheduler, const std::atomic<bool>& bStop, size_t emptyPollsBeforeYield)
+        {
+            size_t emptyPolls = 0;
+            while(!bStop.load(std::memory_order_relaxed))
+            {
+                if(pScheduler->poll(0) != 0)
+                {
+                    emptyPolls = 0;
+                    continue;
+                }
+
+                details::cpuRelax();
+                if(emptyPollsBeforeYield != 0 && ++emptyPolls >= emptyPollsBeforeYield)
+                {
+                    emptyPolls = 0;
+                    std::this_thread::yield();
+                }
+            }
+        }
+    };
+}
\ No newline at end of file
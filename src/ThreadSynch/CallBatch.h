@@ -0,0 +1,95 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include "FramePool.h"
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        /*!@class CallBatch
+        ** @brief The completion state shared by the calls of a batch, as scheduled by CallScheduler::asyncCallBatch.
+        ** @remark
+        **   The batch counts the calls which have yet to finish, whether by completing or by being cancelled,
+        **   and signals a single event when the last one does. Every call in the batch holds a reference to it,
+        **   so it stays alive until the last call is done with it.
+        */
+        class CallBatch : private boost::noncopyable
+        {
+        public:
+            explicit CallBatch(size_t callCount)
+                : m_pendingCount(callCount),
+                  m_referenceCount(0)
+            {
+                if(callCount == 0)
+                {
+                    m_completedEvent.set();
+                }
+            }
+
+            static void* operator new(size_t size)
+            {
+                return FramePool::allocate(size);
+            }
+
+            static void operator delete(void* p)
+            {
+                FramePool::deallocate(p);
+            }
+
+            /*!
+            ** @brief Called once by each call in the batch, when it has completed or been cancelled.
+            */
+            void onCallFinished()
+            {
+                if(m_pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    m_completedEvent.set();
+                }
+            }
+
+            /*!
+            ** @brief Waits for every call in the batch to complete or be cancelled.
+            ** @retval TRUE if all calls are done.
+            ** @retval FALSE if the wait timed out.
+            */
+            BOOL waitForCompletion(DWORD dwTimeout) const
+            {
+                return m_completedEvent.wait(dwTimeout);
+            }
+
+            friend inline void intrusive_ptr_add_ref(CallBatch* pBatch)
+            {
+                pBatch->m_referenceCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            friend inline void intrusive_ptr_release(CallBatch* pBatch)
+            {
+                if(pBatch->m_referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete pBatch;
+                }
+            }
+
+        private:
+            CompletionEvent m_completedEvent;
+            std::atomic<size_t> m_pendingCount;
+            std::atomic<long> m_referenceCount;
+        };
+    }
+}
\ No newline at end of file
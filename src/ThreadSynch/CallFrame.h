@@ -0,0 +1,74 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include "CallHandler.h"
+#include "FunctorRetvalBinder.h"
+#include "ExceptionExpecter.h"
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        /*!@class CallFrame
+        ** @brief Everything a scheduled call needs, laid out in a single block.
+        ** @remark
+        **   The frame embeds the functor and the inline return value (through FunctorRetvalBinder),
+        **   and the exception expecter, next to the CallHandler state. It is allocated from the
+        **   scheduling thread's FramePool, so a call costs no heap allocations once the pool is warm.
+        **
+        **   The functor is kept as its own type. The frame's virtual functions are the only type
+        **   erasure on the call path, so executing a call is a single indirect call.
+        */
+        template<typename T, class E, class Functor>
+        class CallFrame : public CallHandler
+        {
+        public:
+            /*!
+            ** @param[in] arguments constructor arguments for the functor, which is constructed in place in the frame.
+            */
+            template<class... Arguments>
+            explicit CallFrame(Arguments&&... arguments)
+                : m_binder(std::forward<Arguments>(arguments)...)
+            {
+                m_pReturnValue = m_binder.getReturnValueBuffer();
+            }
+
+        protected:
+            virtual BOOL executeCall()
+            {
+                return m_expecter.execute(m_binder) != CaughtExceptionType_None;
+            }
+
+            virtual void releaseCallFunctor()
+            {
+                m_binder.releaseFunctor();
+            }
+
+            virtual void rethrowCaughtException(const boost::intrusive_ptr<CallHandler>& pOwner)
+            {
+                m_expecter.rethrow(pOwner);
+            }
+
+        private:
+            static_assert(boost::alignment_of<FunctorRetvalBinder<T, Functor>>::value <= FramePool::ALIGNMENT, "return types may not be over-aligned");
+
+            FunctorRetvalBinder<T, Functor> m_binder;
+            ExceptionExpecter<E> m_expecter;
+        };
+    }
+}
\ No newline at end of file
@@ -16,17 +16,42 @@
 
 #pragma once
 
-#include "FunctorRetvalBinder.h"
-#include "ExceptionExpecter.h"
+#include "FramePool.h"
+#include "CallBatch.h"
+#include "CallSchedulerExceptions.h"
 
 namespace ThreadSynch
 {
+	namespace details
+	{
+		class Mailbox;
+
+		/*!
+		** @brief The lifecycle of a scheduled call. A call starts out queued, and is then either claimed
+		**   by the target thread or cancelled by the caller -- whichever gets there first. A claimed call 
+		**   always runs to completion. A coalesced call may also be superseded by a later one.
+		*/
+		enum CallState
+		{
+			CallState_Queued,
+			CallState_Claimed,
+			CallState_Completed,
+			CallState_Cancelled,
+			CallState_Superseded,
+			CallState_Dropped
+		};
+	}
+
 	/*!@class CallHandler
 	** @brief A class which stores information about a cross thread call.
 	** This class will keep a functor with bound parameters prior to a synchronized call,
 	** and provide a return value and exception information upon completion.
+	** @remark
+	**   CallHandler is the type independent part of a call frame. The functor, the expected
+	**   exceptions and the return value live in the derived details::CallFrame, which is 
+	**   allocated as a single block from the scheduling thread's details::FramePool.
 	*/
-	class CallHandler
+	class CallHandler : private boost::noncopyable
 	{
 	public:
 		/************************************************************************
@@ -37,20 +62,20 @@ namespace ThreadSynch
 		CallHandler();
 
 		/*! Destructor */
-		~CallHandler();
+		virtual ~CallHandler();
 
 		/*! 
-		** @brief function which sets the callback functor to be run.
-		** @param[in] func 
-		**   A functor which accepts no parameters, and returns a 
-		**   type T or no value at all (void).
-		** @remarks 
-		**   All functor parameters must be bound with boost::bind.
+		** @brief Call frames are allocated from, and recycled to, the calling thread's frame pool.
 		*/
-        template<typename T, class E>
-        typename boost::disable_if<boost::is_void<T>>::type setCallFunctor(boost::function<T()> func);
-        template<typename T, class E>
-        typename boost::enable_if<boost::is_void<T>>::type setCallFunctor(boost::function<T()> func);
+		static void* operator new(size_t size)
+		{
+			return details::FramePool::allocate(size);
+		}
+
+		static void operator delete(void* p)
+		{
+			details::FramePool::deallocate(p);
+		}
 
 		/*! 
 		** @brief Waits for completion
@@ -62,25 +87,42 @@ namespace ThreadSynch
 		*/
 		inline BOOL waitForCompletion(DWORD dwTimeout) const
 		{
-			if(WaitForSingleObject(m_hCompletedEvent, dwTimeout) == WAIT_TIMEOUT)
-				return FALSE;
-			return TRUE;
+			return m_completedEvent.wait(dwTimeout);
+		}
+
+		/*! 
+		** @return Whether or not the call has completed or been withdrawn. Never blocks.
+		*/
+		inline BOOL isFinished() const
+		{
+			return m_completedEvent.isSet();
+		}
+
+		/*! 
+		** @brief Waits for completion, spinning for a while before parking the thread.
+		** @param[in] timeout how long to wait, or duration::max() to wait without timeouts.
+		** @param[in] spin how long to spin before parking.
+		*/
+		inline BOOL waitForCompletion(std::chrono::steady_clock::duration timeout, std::chrono::steady_clock::duration spin) const
+		{
+			return m_completedEvent.wait(timeout, spin);
 		}
 
 		/*! 
 		** @brief Executes the scheduled function.
 		** The scheduled function is executed and the return value is set.
 		** @remarks
-		**   When the call completes, an event will be signaled to indicate
-		**   that the call has completed. This event will be set regardless
-		**   of whether or not the scheduled call throws an exception.
+		**   The call must have been claimed. When the call completes, an event 
+		**   will be signaled to indicate that the call has completed. This event 
+		**   will be set regardless of whether or not the scheduled call throws an exception.
 		*/
 		inline void executeCallback()
 		{
-			m_executeCall();
+			m_bExceptionCaught = executeCall();
 
-			// Notify Thread A that the call has been completed
-			SetEvent(m_hCompletedEvent);
+			// Publish the return value and exception status, then notify Thread A that the call has been completed
+			m_state.store(details::CallState_Completed, std::memory_order_release);
+			signalFinished();
 		}
 
 		/*!
@@ -95,7 +137,40 @@ namespace ThreadSynch
 		*/
 		inline BOOL isCompleted() const
 		{
-			return (WaitForSingleObject(m_hCompletedEvent, 0) == WAIT_OBJECT_0);
+			return m_state.load(std::memory_order_acquire) == details::CallState_Completed;
+		}
+
+		/*!
+		** @return Whether or not the call was cancelled, superseded or dropped, before it could run.
+		*/
+		inline BOOL isCancelled() const
+		{
+			long state = m_state.load(std::memory_order_acquire);
+			return state == details::CallState_Cancelled || state == details::CallState_Superseded || state == details::CallState_Dropped;
+		}
+
+		/*!
+		** @return Whether or not the call was superseded by a later call with the same coalescing key.
+		*/
+		inline BOOL isSuperseded() const
+		{
+			return m_state.load(std::memory_order_acquire) == details::CallState_Superseded;
+		}
+
+		/*!
+		** @return Whether or not the call was dropped from a full mailbox, to make room for a newer call.
+		*/
+		inline BOOL isDropped() const
+		{
+			return m_state.load(std::memory_order_acquire) == details::CallState_Dropped;
+		}
+
+		/*!
+		** @return Whether or not the call is still waiting to be picked up.
+		*/
+		inline BOOL isQueued() const
+		{
+			return m_state.load(std::memory_order_acquire) == details::CallState_Queued;
 		}
 		
 		/*!
@@ -110,187 +185,306 @@ namespace ThreadSynch
 
 		/*! 
 		** @brief Gets the stored return value.
-		** @return The return value as stored by the call.
+		** @return A reference to the return value, as stored in the frame by the call.
+		** @remark
+		**   The value lives as long as the handler. A caller which is the value's only consumer may
+		**   move it out, which is how syncCall and Future::take avoid copying the result.
 		*/
 		template<typename T>
-		inline typename boost::disable_if<boost::is_void<T>, T>::type getReturnValue() const
+		inline typename boost::disable_if<boost::is_void<T>, T&>::type getReturnValue()
 		{
-			return *reinterpret_cast<T*>(m_pReturnValue.get());
+			return *reinterpret_cast<T*>(m_pReturnValue);
 		}
 
 		/*! 
-		** @brief Rethrows an exception thrown by the exception expecter
+		** @brief Rethrows an exception thrown by the exception expecter. Never returns, so it must only be 
+		**        called once caughtException() reports an exception.
+		** @remark The exception object holds a reference to the handler, which keeps it alive until the
+		**         exception has been caught and destroyed.
 		*/
-		inline void rethrowException(boost::function<void()> onExceptionDestroyed)
+		[[noreturn]] void rethrowException()
 		{
-			m_rethrowException(onExceptionDestroyed);
+			rethrowCaughtException(boost::intrusive_ptr<CallHandler>(this));
+
+			// The frame only returns if it caught nothing
+			throw UnexpectedException();
 		}
 
 		/*! 
-		** @brief Opens up for locks on the structure.
-		** @return A try_mutex for this structure, which can
-		**   either be scoped_try_lock'ed or scoped_lock'ed.
+		** @brief Claims a queued call for execution. Called by the target thread before executeCallback.
+		** @retval TRUE the call is now claimed, and must be executed.
+		** @retval FALSE the call was cancelled, and must be discarded.
 		*/
-		inline boost::try_mutex* getAccessMutex() const
+		inline BOOL claim()
 		{
-			return &m_accessMutex;
+			long expected = details::CallState_Queued;
+			return m_state.compare_exchange_strong(expected, details::CallState_Claimed, std::memory_order_acquire, std::memory_order_relaxed);
 		}
 
-	private:
-		/************************************************************************
-		** Variables
+		/*! 
+		** @brief Cancels a queued call, causing the picking up thread to discard it rather than run it.
+		** @retval TRUE the call was cancelled, and will never run.
+		** @retval FALSE the call has already been claimed, completed or cancelled.
+		** @remarks
+		**   Constant time: the handler stays linked in its mailbox until the target thread drains it,
+		**   but the functor and any bound parameters are released right away. The completion event is
+		**   set, so waiters wake up and find the call cancelled.
 		*/
+		inline BOOL cancel()
+		{
+			return withdraw(details::CallState_Cancelled);
+		}
 
 		/*! 
-		** An inner event handle which signals completion.
+		** @brief Cancels a queued call in favour of a later one with the same coalescing key.
+		** @retval TRUE the call was superseded, and will never run.
+		** @retval FALSE the call has already been claimed, completed or cancelled.
 		*/
-		HANDLE m_hCompletedEvent;
+		inline BOOL supersede()
+		{
+			return withdraw(details::CallState_Superseded);
+		}
 
 		/*! 
-		** Memory block which receives and stores the return value of the scheduled function.
+		** @brief Cancels a queued call to make room for a newer one in a full mailbox, or because the target
+		**   thread couldn't be notified of it. Either way, the call's room in the mailbox is given back now.
+		** @retval TRUE the call was dropped, and will never run.
+		** @retval FALSE the call has already been claimed, completed or cancelled.
 		*/
-		boost::scoped_array<BYTE> m_pReturnValue;
-		
+		inline BOOL drop()
+		{
+			return withdraw(details::CallState_Dropped);
+		}
+
 		/*! 
-		** A functor which executes the call and attempts to retrieve the return value.
+		** @brief Has another event set when the call completes or is withdrawn, on top of its own. This is how
+		**   a pumping wait wakes up for either its call, or calls scheduled to its own thread.
+		** @param[in] pWatcher the event, which must outlive the call.
+		** @retval TRUE the event is now watching the call. Once done, the watcher must call unwatchCompletion.
+		** @retval FALSE another event already is.
+		** @remark If the call is finished by the time this returns, the event may not have been set.
 		*/
-		boost::function<void()> m_executeCall;
+		inline BOOL watchCompletion(details::CompletionEvent* pWatcher)
+		{
+			details::CompletionEvent* pExpected = NULL;
+			if(!m_pCompletionWatcher.compare_exchange_strong(pExpected, pWatcher, std::memory_order_seq_cst))
+			{
+				return FALSE;
+			}
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return TRUE;
+		}
+
+		inline void unwatchCompletion()
+		{
+			m_pCompletionWatcher.store(NULL, std::memory_order_relaxed);
+		}
 
 		/*! 
-		** A functor which rethrows exceptions picked up by the expecter.
-		** The functor accepts one parameter, which is another functor to be
-		** called as a thrown exception object is destroyed.
+		** @brief Marks the call as coalesced under the specified key. Must be called before the call is queued.
 		*/
-		boost::function<void(boost::function<void()>)> m_rethrowException;
+		inline void setCoalescingKey(ULONG_PTR key)
+		{
+			m_coalescingKey = key;
+			m_bCoalesced = TRUE;
+		}
+
+		inline BOOL isCoalesced() const
+		{
+			return m_bCoalesced;
+		}
+
+		inline ULONG_PTR getCoalescingKey() const
+		{
+			return m_coalescingKey;
+		}
 
 		/*! 
-		** A functor which instructs the retval binder class to free itself -- needed 
-		** since we cannot reference the class without full template parameter information.
+		** @brief Sets the time by which the call must be picked up. A call which is still queued past its
+		**   deadline is cancelled by the target thread, rather than run.
+		** @remarks Must be called before the call is queued. An earlier deadline already set is kept.
 		*/
-		boost::function<void()> m_freeRetvalBinder;
+		inline void setDeadline(const std::chrono::steady_clock::time_point& deadline)
+		{
+			if(deadline < m_deadline)
+			{
+				m_deadline = deadline;
+			}
+		}
 
 		/*! 
-		** A functor which instructs the exception expecter class to free itself -- needed 
-		** since we cannot reference the class without full template parameter information.
+		** @return The call's deadline, or std::chrono::steady_clock::time_point::max() if it has none.
 		*/
-		boost::function<void()> m_freeExceptionExpecter;
+		inline const std::chrono::steady_clock::time_point& getDeadline() const
+		{
+			return m_deadline;
+		}
+
+		inline BOOL hasDeadline() const
+		{
+			return m_deadline != std::chrono::steady_clock::time_point::max();
+		}
 
 		/*! 
-		** Inner mutex which provides locking functionality on the structure.
+		** @brief Makes the call part of a batch, which will be notified when the call completes or is cancelled.
+		** @remarks Must be called before the call is queued. The handler holds a reference to the batch.
 		*/
-		mutable boost::try_mutex m_accessMutex;
+		inline void joinBatch(details::CallBatch* pBatch)
+		{
+			intrusive_ptr_add_ref(pBatch);
+			m_pBatch = pBatch;
+		}
 
 		/*! 
-		** Indicates whether or not setCallFunctor has been called already
+		** @brief Intrusive reference counting, for boost::intrusive_ptr. A queued handler is referenced 
+		**   by its mailbox, so it stays alive until the target thread drains it, even if the caller
+		**   has already given up on the call.
 		*/
-		BOOL m_bCallFunctorSet;
+		friend inline void intrusive_ptr_add_ref(CallHandler* pCallHandler)
+		{
+			pCallHandler->m_referenceCount.fetch_add(1, std::memory_order_relaxed);
+		}
 
-		/*!
-		** Indicates whether or not an exception was thrown by the call
+		friend inline void intrusive_ptr_release(CallHandler* pCallHandler)
+		{
+			if(pCallHandler->m_referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				delete pCallHandler;
+			}
+		}
+
+	protected:
+		/*! 
+		** @brief Runs the functor, storing its return value or catching its exception.
+		** @return Whether or not an exception was caught.
 		*/
-		BOOL m_bExceptionCaught;
+		virtual BOOL executeCall() = 0;
 
 		/*!
-		** @brief notification that the scheduled call handled threw an exception
-		** @param[in] etype Specifies which exception, if any, was thrown
-		** @remark
-		** 	 Called by the exception expecter when a call has been completed,
-		**   in context of the thread that does the pickup.
+		** @brief Frees the functor, along with any bound parameters.
 		*/
-		void onExceptionExpecterComplete(details::CaughtExceptionType etype);
-	};
-
-	/************************************************************************
-	** Implementation of non-inline template member functions for CallHandler
-	*/
+		virtual void releaseCallFunctor() = 0;
 
-	CallHandler::CallHandler()
-		: m_bCallFunctorSet(FALSE),
-		  m_bExceptionCaught(FALSE)
-	{
-		m_hCompletedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-	}
+		/*! 
+		** @brief Has the exception expecter rethrow what it caught. Returns if it caught nothing.
+		*/
+		virtual void rethrowCaughtException(const boost::intrusive_ptr<CallHandler>& pOwner) = 0;
 
-	CallHandler::~CallHandler()
-	{
-		CloseHandle(m_hCompletedEvent);
+		/*! 
+		** The frame's return value storage. NULL for calls which return void.
+		*/
+		void* m_pReturnValue;
 
-		// Deallocate retval binder, if one is set
-		if(m_freeRetvalBinder)
+	private:
+		/*! 
+		** @brief Moves a queued call to a final state in which it won't run.
+		*/
+		inline BOOL withdraw(details::CallState state)
 		{
-			m_freeRetvalBinder();
-		}
+			long expected = details::CallState_Queued;
+			if(!m_state.compare_exchange_strong(expected, state, std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				return FALSE;
+			}
+			releaseCallFunctor();
 
-		// Deallocate the exception expecter, if one is set
-		if(m_freeExceptionExpecter)
-		{
-			m_freeExceptionExpecter();
+			// Wake anyone waiting for the call, such as other copies of its Future
+			signalFinished();
+			return TRUE;
 		}
-	}
 
-	template<typename T, class E>
-    typename boost::disable_if<boost::is_void<T>>::type CallHandler::setCallFunctor(boost::function<T()> func)
-	{
-		// Disallow multiple runs
-		if(m_bCallFunctorSet)
+		/*! 
+		** @brief Sets the completion event, and tells whoever else is watching the call that it's done.
+		*/
+		inline void signalFinished()
 		{
-			throw std::exception("Callback already set");
+			m_completedEvent.set();
+			details::CompletionEvent* pWatcher = m_pCompletionWatcher.load(std::memory_order_seq_cst);
+			if(pWatcher != NULL)
+			{
+				pWatcher->set();
+			}
+			if(m_pBatch != NULL)
+			{
+				m_pBatch->onCallFinished();
+			}
 		}
-		m_bCallFunctorSet = TRUE;
 
-		m_pReturnValue.reset(new BYTE[sizeof(T)]);
-		
-		// Create a loose ExceptionExpecter instance. The instance will be free'd through the
-		// m_freeExceptionExpecter functor, called in the CallHandler destructor.
-		ExceptionExpecter<E>* expecter = new ExceptionExpecter<E>(boost::bind(&CallHandler::onExceptionExpecterComplete, this, _1));
-		m_rethrowException = boost::bind(&ExceptionExpecter<E>::rethrow, expecter, _1);
-		m_freeExceptionExpecter = boost::bind(&ExceptionExpecter<E>::free, expecter);
-
-		// Create a loose FunctorRetvalBinder instance. The instance will be free'd through the
-		// m_freeRetvalBinder functor, called in the CallHandler destructor.
-		FunctorRetvalBinder<T>* binder = new FunctorRetvalBinder<T>(func, m_pReturnValue.get());
-		m_freeRetvalBinder = boost::bind(&FunctorRetvalBinder<T>::free, binder);
-
-		// Setup the main execution functor, which will wrap both expected exceptions and
-		// return value.
-		m_executeCall = boost::bind(&ExceptionExpecter<E>::execute, 
-									expecter, 
-									static_cast<boost::function<void()>>(boost::bind(&FunctorRetvalBinder<T>::execute, binder)));
-	}
+		/************************************************************************
+		** Variables
+		*/
 
-	template<typename T, class E>
-    typename boost::enable_if<boost::is_void<T>>::type CallHandler::setCallFunctor(boost::function<T()> func)
-	{
-		// Disallow multiple runs
-		if(m_bCallFunctorSet)
-		{
-			throw std::exception("Callback already set");
-		}
-		m_bCallFunctorSet = TRUE;
+		/*! 
+		** An inner event which signals completion.
+		*/
+		details::CompletionEvent m_completedEvent;
+
+		/*!
+		** Indicates whether or not an exception was thrown by the call
+		*/
+		BOOL m_bExceptionCaught;
+
+		/*!
+		** The call's CallState. The target thread and the caller race on it with compare-and-swap.
+		*/
+		std::atomic<long> m_state;
+
+		/*!
+		** Number of boost::intrusive_ptr references, including the one held by a mailbox
+		*/
+		std::atomic<long> m_referenceCount;
 
-		// Create a loose ExceptionExpecter instance. The instance will be free'd through the
-		// m_freeExceptionExpecter functor, called in the CallHandler destructor.
-		ExceptionExpecter<E>* expecter = new ExceptionExpecter<E>(boost::bind(&CallHandler::onExceptionExpecterComplete, this, _1));
-		m_rethrowException = boost::bind(&ExceptionExpecter<E>::rethrow, expecter, _1);
-		m_freeExceptionExpecter = boost::bind(&ExceptionExpecter<E>::free, expecter);
+		/*!
+		** The batch the call belongs to, or NULL
+		*/
+		details::CallBatch* m_pBatch;
+
+		/*!
+		** The event of a pumping wait for the call, or NULL
+		*/
+		std::atomic<details::CompletionEvent*> m_pCompletionWatcher;
 
-		// Create a loose FunctorRetvalBinder instance. The instance will be free'd through the
-		// m_freeRetvalBinder functor, called in the CallHandler destructor.
-		FunctorRetvalBinder<T>* binder = new FunctorRetvalBinder<T>(func, m_pReturnValue.get());
-		m_freeRetvalBinder = boost::bind(&FunctorRetvalBinder<T>::free, binder);
+		/*!
+		** The time by which the call must be picked up, or time_point::max()
+		*/
+		std::chrono::steady_clock::time_point m_deadline;
 
-		// Setup the main execution functor, which will wrap both expected exceptions and
-		// return value.
-		m_executeCall = boost::bind(&ExceptionExpecter<E>::execute, 
-									expecter, 
-									static_cast<boost::function<void()>>(boost::bind(&FunctorRetvalBinder<T>::execute, binder)));
+		/*!
+		** The key the call was coalesced under by CallScheduler::asyncCallCoalesced, if m_bCoalesced is set
+		*/
+		ULONG_PTR m_coalescingKey;
+		BOOL m_bCoalesced;
+
+		/*!
+		** Link to the next handler in the mailbox this handler is queued in
+		*/
+		CallHandler* m_pNextQueued;
+		friend class details::Mailbox;
+	};
+
+	/************************************************************************
+	** Implementation of non-inline member functions for CallHandler
+	*/
+
+	inline CallHandler::CallHandler()
+		: m_pReturnValue(NULL),
+		  m_bExceptionCaught(FALSE),
+		  m_state(details::CallState_Queued),
+		  m_referenceCount(0),
+		  m_pBatch(NULL),
+		  m_pCompletionWatcher(NULL),
+		  m_deadline(std::chrono::steady_clock::time_point::max()),
+		  m_coalescingKey(0),
+		  m_bCoalesced(FALSE),
+		  m_pNextQueued(NULL)
+	{
 	}
 
-	void CallHandler::onExceptionExpecterComplete(details::CaughtExceptionType etype)
+	inline CallHandler::~CallHandler()
 	{
-		if(etype != details::CaughtExceptionType_None)
+		if(m_pBatch != NULL)
 		{
-			m_bExceptionCaught = TRUE;
+			intrusive_ptr_release(m_pBatch);
 		}
 	}
 }
\ No newline at end of file
@@ -19,10 +19,13 @@
 #include <boost/mpl/is_sequence.hpp>
 #include <boost/mpl/or.hpp>
 #include <boost/mpl/and.hpp>
-#include "CallHandler.h"
+#include "CallFrame.h"
+#include "BoundCall.h"
+#include "Mailbox.h"
 #include "PickupPolicyProvider.h"
 #include "CallSchedulerExceptions.h"
 #include "Future.h"
+#include "BatchFuture.h"
 
 namespace ThreadSynch
 {
@@ -73,7 +76,7 @@ namespace ThreadSynch
 
 		/*! 
 		** @brief schedules calls to be made across threads, and expects a few exceptions might be thrown.
-		** @param[in] dwThreadId the id of the thread to make the call in.
+		** @param[in] target the thread to make the call in; either its id, or an endpoint from getEndpoint.
 		** @param[in] callback functor which executes the callback.
 		** @param[in] dwTimeout number of milliseconds to wait before terminating.
 		** @param[in] ReturnValueType return value, usually deduced, but specify to avoid possibly cryptic errors.
@@ -82,11 +85,11 @@ namespace ThreadSynch
 		*/
         template<typename ReturnValueType, class Exceptions>
         typename boost::disable_if<IS_VOID_OR_SEQUENCE(ReturnValueType), ReturnValueType>::
-        type syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout);
+        type syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout);
 
 		/*! 
 		** @brief schedules calls to be made across threads, and expects a few exceptions might be thrown.
-		** @param[in] dwThreadId the id of the thread to make the call in.
+		** @param[in] target the thread to make the call in; either its id, or an endpoint from getEndpoint.
 		** @param[in] callback functor which executes the callback.
 		** @param[in] dwTimeout number of milliseconds to wait before terminating.
         ** @param[in] ReturnValueType return value, usually deduced, but specify to avoid possibly cryptic errors.
@@ -94,45 +97,45 @@ namespace ThreadSynch
 		*/
         template<typename ReturnValueType, class Exceptions>
         typename boost::enable_if<boost::is_void<ReturnValueType>, ReturnValueType>::
-        type syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout);
+        type syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout);
 
 #pragma region syncCall template parameter redirections
         // ReturnValueType IS NOT void AND ReturnValueType IS NOT MPL Sequence redirection
         template<typename ReturnValueType>
         typename boost::disable_if<IS_VOID_OR_SEQUENCE(ReturnValueType), ReturnValueType>::
-        type syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
+        type syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
         {
-            return syncCall<ReturnValueType, ExceptionTypes<>>(dwThreadId, callback, dwTimeout);
+            return syncCall<ReturnValueType, ExceptionTypes<>>(target, callback, dwTimeout);
         }
 
         // ReturnValueType IS void redirection
         template<typename ReturnValueType>
         typename boost::enable_if<boost::is_void<ReturnValueType>, ReturnValueType>::
-        type syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
+        type syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
         {
-            syncCall<ReturnValueType, ExceptionTypes<>>(dwThreadId, callback, dwTimeout);
+            syncCall<ReturnValueType, ExceptionTypes<>>(target, callback, dwTimeout);
         }
 
         // ReturnValueType IS NOT void AND Exceptions IS Sequence redirection
         template<typename Exceptions, typename ReturnValueType>
         typename boost::enable_if<X_IS_NON_VOID_AND_Y_IS_SEQUENCE(ReturnValueType, Exceptions), ReturnValueType>::
-            type syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
+            type syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
         {
-            return syncCall<ReturnValueType, Exceptions>(dwThreadId, callback, dwTimeout);
+            return syncCall<ReturnValueType, Exceptions>(target, callback, dwTimeout);
         }
 
         // ReturnValueType IS void AND Exceptions IS Sequence redirection
         template<typename Exceptions, typename ReturnValueType>
         typename boost::enable_if<X_IS_VOID_AND_Y_IS_SEQUENCE(ReturnValueType, Exceptions), ReturnValueType>::
-        type syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
+        type syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
         {
-            syncCall<ReturnValueType, Exceptions>(dwThreadId, callback, dwTimeout);
+            syncCall<ReturnValueType, Exceptions>(target, callback, dwTimeout);
         }
 #pragma endregion
 
         /*! 
         ** @brief schedules calls to be made across threads, and expects a few exceptions might be thrown.
-        ** @param[in] dwThreadId the id of the thread to make the call in.
+        ** @param[in] target the thread to make the call in; either its id, or an endpoint from getEndpoint.
         ** @param[in] callback functor which executes the callback.
         ** @param[in] ReturnValueType return value type. This template overload handles non-void types.
         ** @param[in] Exceptions expected exceptions, specified as a comma separated template parameters to ExceptionTypes.
@@ -142,11 +145,11 @@ namespace ThreadSynch
         */
         template<typename ReturnValueType, class Exceptions>
         typename boost::disable_if<IS_VOID_OR_SEQUENCE(ReturnValueType), Future<ReturnValueType>>::
-        type asyncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback);
+        type asyncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback);
 
         /*! 
         ** @brief schedules calls to be made across threads, and expects a few exceptions might be thrown.
-        ** @param[in] dwThreadId the id of the thread to make the call in.
+        ** @param[in] target the thread to make the call in; either its id, or an endpoint from getEndpoint.
         ** @param[in] callback functor which executes the callback.
         ** @param[in] ReturnValueType return value type. This template overload handles the void type only.
         ** @param[in] Exceptions expected exceptions, specified as a comma separated template parameters to ExceptionTypes.
@@ -156,39 +159,422 @@ namespace ThreadSynch
         */
         template<typename ReturnValueType, class Exceptions>
         typename boost::enable_if<boost::is_void<ReturnValueType>, Future<ReturnValueType>>::
-        type asyncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback);
+        type asyncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback);
 
 #pragma region asyncCall template parameter redirections
         // ReturnValueType IS NOT MPL Sequence redirection
         template<typename ReturnValueType>
         typename boost::disable_if<boost::mpl::is_sequence<ReturnValueType>, Future<ReturnValueType>>::
-        type asyncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback)
+        type asyncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback)
         {
-            return asyncCall<ReturnValueType, ExceptionTypes<>>(dwThreadId, callback);
+            return asyncCall<ReturnValueType, ExceptionTypes<>>(target, callback);
         }
 
         // Exceptions IS MPL Sequence redirection
         template<typename Exceptions, typename ReturnValueType>
         typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, Future<ReturnValueType>>::
-        type asyncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback)
+        type asyncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback)
         {
-            return asyncCall<ReturnValueType, Exceptions>(dwThreadId, callback);
+            return asyncCall<ReturnValueType, Exceptions>(target, callback);
+        }
+#pragma endregion
+
+#pragma region variadic syncCall and asyncCall
+        /*! 
+        ** @brief schedules a call to a callable with the specified arguments, and waits for it to complete.
+        ** @param[in] target the thread to make the call in; either its id, or an endpoint from getEndpoint.
+        ** @param[in] functor a function, function object, lambda or pointer to member function.
+        ** @param[in] arguments the arguments to call the functor with. For a pointer to member function, the first
+        **            argument is the object. The arguments are stored once, in the call frame, and are moved rather
+        **            than copied when passed as rvalues. Like with std::thread, use std::ref to pass a reference.
+        ** @return the value returned by the call. The return type is deduced from the call.
+        ** @remark
+        **   The call waits for completion without a timeout. Expected exceptions can be specified as the sole
+        **   template parameter, as in syncCall<ExceptionTypes<E1, E2>>(target, functor, arguments...). Bind
+        **   expressions accept, and ignore, any arguments, so they're only taken without arguments, or with a
+        **   trailing timeout, as in syncCall(target, boost::bind(f, a), dwTimeout).
+        **   A thread which targets itself runs the call inline, right away, as it could never pick it up while
+        **   waiting for it. This holds for every syncCall flavor. Likewise, a call to a thread which is itself
+        **   blocked on a call to the calling thread throws CallDeadlockException, rather than wait forever.
+        */
+        template<class Functor, class... Arguments>
+        typename details::BoundCallResult<Functor, Arguments...>::
+        type syncCall(const ThreadEndpoint& target, Functor&& functor, Arguments&&... arguments)
+        {
+            return syncCall<ExceptionTypes<>>(target, INFINITE, std::forward<Functor>(functor), std::forward<Arguments>(arguments)...);
+        }
+
+        template<class Exceptions, class Functor, class... Arguments>
+        typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, typename details::BoundCallResult<Functor, Arguments...>::type>::
+        type syncCall(const ThreadEndpoint& target, Functor&& functor, Arguments&&... arguments)
+        {
+            return syncCall<Exceptions>(target, INFINITE, std::forward<Functor>(functor), std::forward<Arguments>(arguments)...);
+        }
+
+        /*! 
+        ** @brief schedules a call to a callable with the specified arguments, and waits a limited time for it to complete.
+        ** @param[in] dwTimeout number of milliseconds to wait before terminating.
+        ** @throw CallTimeoutException if the call wasn't picked up in time. CallDeadlockException, a CallTimeoutException,
+        **        if the target thread is blocked on the calling thread, and the call would never have been.
+        ** @sa syncCall(const ThreadEndpoint&, Functor&&, Arguments&&...)
+        */
+        template<class Functor, class... Arguments>
+        typename details::BoundCallResult<Functor, Arguments...>::
+        type syncCall(const ThreadEndpoint& target, DWORD dwTimeout, Functor&& functor, Arguments&&... arguments)
+        {
+            return syncCall<ExceptionTypes<>>(target, dwTimeout, std::forward<Functor>(functor), std::forward<Arguments>(arguments)...);
+        }
+
+        template<class Exceptions, class Functor, class... Arguments>
+        typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, typename details::BoundCallResult<Functor, Arguments...>::type>::
+        type syncCall(const ThreadEndpoint& target, DWORD dwTimeout, Functor&& functor, Arguments&&... arguments)
+        {
+            typedef details::BoundCall<Functor, Arguments...> BoundCallType;
+            typedef typename BoundCallType::ResultType ReturnValueType;
+
+            // The functor and its arguments are constructed straight into the frame
+            boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, BoundCallType>(std::forward<Functor>(functor), std::forward<Arguments>(arguments)...));
+            return makeSyncCall<ReturnValueType>(target, pCallHandler, details::toTimeout(dwTimeout));
+        }
+
+        /*! 
+        ** @brief schedules a call to a callable with the specified arguments, and waits a limited time for it to complete.
+        ** @param[in] timeout how long to wait before terminating, in any std::chrono duration. Timeouts are
+        **            kept to the precision of std::chrono::steady_clock, so sub-millisecond timeouts work.
+        ** @throw CallTimeoutException if the call wasn't picked up in time. CallDeadlockException, a CallTimeoutException,
+        **        if the target thread is blocked on the calling thread, and the call would never have been.
+        ** @sa syncCall(const ThreadEndpoint&, Functor&&, Arguments&&...)
+        */
+        template<class Functor, class Rep, class Period, class... Arguments>
+        typename details::BoundCallResult<Functor, Arguments...>::
+        type syncCall(const ThreadEndpoint& target, std::chrono::duration<Rep, Period> timeout, Functor&& functor, Arguments&&... arguments)
+        {
+            return syncCall<ExceptionTypes<>>(target, timeout, std::forward<Functor>(functor), std::forward<Arguments>(arguments)...);
+        }
+
+        template<class Exceptions, class Functor, class Rep, class Period, class... Arguments>
+        typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, typename details::BoundCallResult<Functor, Arguments...>::type>::
+        type syncCall(const ThreadEndpoint& target, std::chrono::duration<Rep, Period> timeout, Functor&& functor, Arguments&&... arguments)
+        {
+            typedef details::BoundCall<Functor, Arguments...> BoundCallType;
+            typedef typename BoundCallType::ResultType ReturnValueType;
+
+            boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, BoundCallType>(std::forward<Functor>(functor), std::forward<Arguments>(arguments)...));
+            return makeSyncCall<ReturnValueType>(target, pCallHandler, details::toTimeout(timeout));
+        }
+
+        /*! 
+        ** @brief schedules a call to a boost::bind or std::bind expression, and waits a limited time for it to complete.
+        ** @param[in] functor the bind expression, with all of its arguments bound.
+        ** @param[in] dwTimeout number of milliseconds to wait before terminating.
+        ** @remark The trailing timeout of the boost::function overloads, without having to name the return type.
+        ** @sa syncCall(const ThreadEndpoint&, DWORD, Functor&&, Arguments&&...)
+        */
+        template<class Functor>
+        typename boost::lazy_enable_if<details::IsBindExpression<Functor>, details::BoundCallResult<Functor>>::
+        type syncCall(const ThreadEndpoint& target, Functor&& functor, DWORD dwTimeout)
+        {
+            return syncCall<ExceptionTypes<>>(target, dwTimeout, std::forward<Functor>(functor));
+        }
+
+        template<class Exceptions, class Functor>
+        typename boost::lazy_enable_if<boost::mpl::and_<boost::mpl::is_sequence<Exceptions>, details::IsBindExpression<Functor>>, details::BoundCallResult<Functor>>::
+        type syncCall(const ThreadEndpoint& target, Functor&& functor, DWORD dwTimeout)
+        {
+            return syncCall<Exceptions>(target, dwTimeout, std::forward<Functor>(functor));
+        }
+
+        /*! 
+        ** @brief schedules a call to a callable with the specified arguments, without waiting for it.
+        ** @param[in] target the thread to make the call in; either its id, or an endpoint from getEndpoint.
+        ** @param[in] functor a function, function object, lambda or pointer to member function.
+        ** @param[in] arguments the arguments to call the functor with, stored as for syncCall.
+        ** @return a Future-object which will hold the result of the async call. The value type is deduced from the call.
+        ** @remark Expected exceptions can be specified as the sole template parameter, as for syncCall.
+        ** @throw std::bad_alloc if the Future object cannot be created
+        */
+        template<class Functor, class... Arguments>
+        Future<typename details::BoundCallResult<Functor, Arguments...>::type>
+        asyncCall(const ThreadEndpoint& target, Functor&& functor, Arguments&&... arguments)
+        {
+            return asyncCall<ExceptionTypes<>>(target, std::forward<Functor>(functor), std::forward<Arguments>(arguments)...);
+        }
+
+        template<class Exceptions, class Functor, class... Arguments>
+        typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, Future<typename details::BoundCallResult<Functor, Arguments...>::type>>::
+        type asyncCall(const ThreadEndpoint& target, Functor&& functor, Arguments&&... arguments)
+        {
+            typedef details::BoundCall<Functor, Arguments...> BoundCallType;
+            typedef typename BoundCallType::ResultType ReturnValueType;
+
+            // The functor and its arguments are constructed straight into the frame
+            boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, BoundCallType>(std::forward<Functor>(functor), std::forward<Arguments>(arguments)...));
+            return makeAsyncCall<ReturnValueType>(target, pCallHandler);
+        }
+#pragma endregion
+
+#pragma region asyncCallBatch
+        /*! 
+        ** @brief schedules a sequence of calls to one thread, as a single batch.
+        ** @param[in] target the thread to make the calls in; either its id, or an endpoint from getEndpoint.
+        ** @param[in] first, last a range of callables taking no arguments, such as lambdas, boost::function or 
+        **            boost::bind expressions. Each is copied into its own call frame.
+        ** @return a BatchFuture-object which holds the results of the calls, in range order.
+        ** @remark
+        **   The calls are added to the target's mailbox in one operation, and run in order with no other calls
+        **   of the same priority in between. The target thread is notified at most once for the whole batch, and completion is
+        **   tracked by a single counter, so the per call cost of scheduling falls with the size of the batch.
+        **   Expected exceptions can be specified as the sole template parameter, as for asyncCall.
+        ** @throw std::bad_alloc if the frames or the BatchFuture object cannot be created. No calls are scheduled.
+        ** @throw CallSchedulingFailedException if the target could not be notified. All calls are cancelled.
+        */
+        template<class Iterator>
+        BatchFuture<typename details::BoundCallResult<typename std::iterator_traits<Iterator>::value_type>::type>
+        asyncCallBatch(const ThreadEndpoint& target, Iterator first, Iterator last)
+        {
+            return asyncCallBatch<ExceptionTypes<>>(target, first, last);
+        }
+
+        template<class Exceptions, class Iterator>
+        typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, BatchFuture<typename details::BoundCallResult<typename std::iterator_traits<Iterator>::value_type>::type>>::
+        type asyncCallBatch(const ThreadEndpoint& target, Iterator first, Iterator last)
+        {
+            typedef details::BoundCall<typename std::iterator_traits<Iterator>::value_type> BoundCallType;
+            typedef typename BoundCallType::ResultType ReturnValueType;
+
+            // Build every frame before touching the mailbox, so that a failed allocation schedules nothing
+            typename BatchFuture_Impl<ReturnValueType>::CALLHANDLERS callHandlers;
+            callHandlers.reserve(std::distance(first, last));
+            for(; first != last; ++first)
+            {
+                callHandlers.push_back(new details::CallFrame<ReturnValueType, Exceptions, BoundCallType>(*first));
+            }
+
+            boost::intrusive_ptr<details::CallBatch> pBatch(new details::CallBatch(callHandlers.size()));
+            for(size_t i = 0; i < callHandlers.size(); ++i)
+            {
+                callHandlers[i]->joinBatch(pBatch.get());
+            }
+
+            // The future takes over the vector's buffer, which stays put
+            const boost::intrusive_ptr<CallHandler>* pFirst = callHandlers.data();
+            const boost::intrusive_ptr<CallHandler>* pLast = pFirst + callHandlers.size();
+            BatchFuture<ReturnValueType> future(callHandlers, pBatch);
+            enqueueThreadCalls(target, pFirst, pLast, TRUE);
+            return future;
+        }
+
+        /*! 
+        ** @brief schedules every callable in a range, as a single batch.
+        ** @sa asyncCallBatch(const ThreadEndpoint&, Iterator, Iterator)
+        */
+        template<class Range>
+        BatchFuture<typename details::BoundCallResult<typename Range::value_type>::type>
+        asyncCallBatch(const ThreadEndpoint& target, const Range& callbacks)
+        {
+            return asyncCallBatch<ExceptionTypes<>>(target, callbacks.begin(), callbacks.end());
+        }
+
+        template<class Exceptions, class Range>
+        typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, BatchFuture<typename details::BoundCallResult<typename Range::value_type>::type>>::
+        type asyncCallBatch(const ThreadEndpoint& target, const Range& callbacks)
+        {
+            return asyncCallBatch<Exceptions>(target, callbacks.begin(), callbacks.end());
+        }
+#pragma endregion
+
+#pragma region asyncCallCoalesced
+        /*! 
+        ** @brief schedules a call which replaces any call with the same key that has yet to start.
+        ** @param[in] target the thread to make the call in; either its id, or an endpoint from getEndpoint.
+        ** @param[in] key identifies what the call updates, such as a widget. Keys are per target thread.
+        ** @param[in] functor a function, function object, lambda or pointer to member function.
+        ** @param[in] arguments the arguments to call the functor with, stored as for asyncCall.
+        ** @return a Future-object which will hold the result of the call. If the call is replaced by a later
+        **         one before it starts, wait and abort report ASYNCH_CALL_SUPERSEDED.
+        ** @remark
+        **   Meant for "refresh X with the latest state" calls. The first call with a key takes a place in 
+        **   the queue, and calls scheduled with the key before the target thread gets there replace each 
+        **   other, so only the latest one runs, in that place. Queue depth and work on the target thread are
+        **   bounded by the number of distinct keys, rather than by the rate of calls. The place keeps the
+        **   priority and deadline ordering of the call which took it. Expected exceptions can be specified 
+        **   as the sole template parameter, as for asyncCall.
+        ** @throw std::bad_alloc if the Future object cannot be created
+        */
+        template<class Functor, class... Arguments>
+        Future<typename details::BoundCallResult<Functor, Arguments...>::type>
+        asyncCallCoalesced(const ThreadEndpoint& target, ULONG_PTR key, Functor&& functor, Arguments&&... arguments)
+        {
+            return asyncCallCoalesced<ExceptionTypes<>>(target, key, std::forward<Functor>(functor), std::forward<Arguments>(arguments)...);
+        }
+
+        template<class Exceptions, class Functor, class... Arguments>
+        typename boost::enable_if<boost::mpl::is_sequence<Exceptions>, Future<typename details::BoundCallResult<Functor, Arguments...>::type>>::
+        type asyncCallCoalesced(const ThreadEndpoint& target, ULONG_PTR key, Functor&& functor, Arguments&&... arguments)
+        {
+            typedef details::BoundCall<Functor, Arguments...> BoundCallType;
+            typedef typename BoundCallType::ResultType ReturnValueType;
+
+            boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, BoundCallType>(std::forward<Functor>(functor), std::forward<Arguments>(arguments)...));
+            pCallHandler->setCoalescingKey(key);
+            return makeAsyncCall<ReturnValueType>(target, pCallHandler);
         }
 #pragma endregion
 
 		/*! 
 		** @brief Executes all scheduled calls for the current thread.
 		** @param[in] pSchedulerInstance which singleton instance to run the operations on.
+		** @remark Stands in for any pickup scheduled to the thread, including one rescheduled for calls left
+		**   over by an earlier pickup. Policies which only wake the thread, such as EventFdPickupPolicy, rely on it.
 		*/
 		static void APIENTRY executeScheduledCalls(CallScheduler* pSchedulerInstance);
 
+		/*! 
+		** @brief Waits for calls to be scheduled to the current thread, and runs them. For worker threads
+		**        which do nothing but run calls, typically with ManualPickupPolicy.
+		** @param[in] dwTimeout number of milliseconds to wait for a call. Specify INFINITE to wait without timeouts.
+		** @param[in] maxCalls the number of calls to run at most, or 0 for no limit. Calls left over are 
+		**            run by the next pump.
+		** @return The number of calls run, or 0 if none were scheduled in time.
+		** @remark
+		**   The thread parks on its own mailbox, and is woken directly by the producer whose call finds it
+		**   parked. Pickups scheduled by the policy, if any, run the same calls, so pumping from a thread which
+		**   other pickups are also delivered to is harmless.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		size_t pump(DWORD dwTimeout, size_t maxCalls);
+
+		/*! 
+		** @brief Waits for calls to be scheduled to the current thread, and runs them.
+		** @param[in] timeout how long to wait for a call, in any std::chrono duration.
+		** @sa pump(DWORD, size_t)
+		*/
+		template<class Rep, class Period>
+		size_t pump(const std::chrono::duration<Rep, Period>& timeout, size_t maxCalls)
+		{
+			return pumpCalls(details::toTimeout(timeout), maxCalls);
+		}
+
+		/*! 
+		** @brief Runs the calls scheduled to the current thread, if there are any, without waiting. For 
+		**        threads which poll for calls in a loop, typically with BusyPollPickupPolicy.
+		** @param[in] maxCalls the number of calls to run at most, or 0 for no limit. Calls left over are 
+		**            run by the next poll.
+		** @return The number of calls run.
+		** @remark An empty poll reads the mailbox, but writes nothing, and never enters the kernel.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		size_t poll(size_t maxCalls);
+
+		/*! 
+		** @brief Resolves a thread to an endpoint, which can be passed to syncCall and asyncCall in place
+		**        of the thread id, saving a thread lookup for every call made through it.
+		** @param[in] dwThreadId the id of the thread to resolve.
+		** @return An endpoint, which remains valid for the lifetime of the scheduler.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		ThreadEndpoint getEndpoint(ThreadId dwThreadId);
+
+		/*! 
+		** @brief Limits the work done each time a thread picks up its scheduled calls, so that a flood of 
+		**        calls can't starve the thread's own work, such as the message loop of a UI thread.
+		** @param[in] target the thread to limit; either its id, or an endpoint from getEndpoint.
+		** @param[in] maxCalls the number of calls a pickup may run, or 0 for no limit.
+		** @param[in] dwMaxMicroseconds the time a pickup may spend running calls, or 0 for no limit. The
+		**            time is checked between calls, so a single long call can overrun it.
+		** @remark
+		**   A pickup which runs out of budget with calls left over schedules another pickup through the
+		**   PickupPolicy, and returns. The remaining calls then run, in order, on the next cycle of the
+		**   thread's wait or message loop. By default pickups are unlimited.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		void setPickupBudget(const ThreadEndpoint& target, size_t maxCalls, DWORD dwMaxMicroseconds);
+
+		/*! 
+		** @brief Selects the order in which a thread runs calls of the same priority.
+		** @param[in] target the thread; either its id, or an endpoint from getEndpoint.
+		** @param[in] bDeadlineOrdering TRUE to run calls earliest deadline first, FALSE to run them in the
+		**            order they were scheduled, which is the default.
+		** @remark
+		**   Calls get a deadline from the timeout of a syncCall, or from an endpoint's withDeadline. Calls
+		**   without one run after those with one. Whatever the order, calls past their deadline are
+		**   discarded without being run.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		void setDeadlineOrdering(const ThreadEndpoint& target, BOOL bDeadlineOrdering);
+
+		/*! 
+		** @brief Bounds the number of calls which may be queued for a thread, so that a stalled thread
+		**        can't make its producers allocate without limit.
+		** @param[in] target the thread; either its id, or an endpoint from getEndpoint.
+		** @param[in] capacity the number of calls which may be queued, or 0 for no limit, which is the default.
+		** @param[in] policy what a producer does when it finds the queue full: wait for room, fail right 
+		**            away, or drop the oldest queued asynchronous call.
+		** @param[in] dwTimeout how long a producer waits for room under QUEUE_FULL_BLOCK, or INFINITE.
+		** @remark
+		**   Producers which don't get room throw CallQueueFullException, which is a 
+		**   CallSchedulingFailedException. A thread scheduling calls to itself never waits for room, as
+		**   it would be waiting for itself. Synchronous calls are never dropped, and calls replaced by 
+		**   asyncCallCoalesced don't take room of their own.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		void setQueueCapacity(const ThreadEndpoint& target, size_t capacity, QUEUE_FULL_POLICY policy, DWORD dwTimeout);
+
+		/*! 
+		** @brief Sets a callback which tells producers when a thread's queue grows deep, and when it has 
+		**        drained again, so that they can throttle at the source.
+		** @param[in] target the thread; either its id, or an endpoint from getEndpoint.
+		** @param[in] highWatermark the queue depth at which the callback is called with TRUE, or 0 for none.
+		** @param[in] lowWatermark the queue depth at which the callback is then called with FALSE.
+		** @param[in] callback the callback. The high watermark is reported by the producer which reaches
+		**            it, and the low one by the target thread, as it runs its calls.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		void setQueueWatermarks(const ThreadEndpoint& target, size_t highWatermark, size_t lowWatermark, const boost::function<void (BOOL bAboveHighWatermark)>& callback);
+
+		/*! 
+		** @return The number of calls queued for a thread, and not yet picked up.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		size_t getQueueDepth(const ThreadEndpoint& target);
+
+		/*! 
+		** @brief Selects whether or not a thread runs the calls scheduled to it while it waits for a call it
+		**        has made, in syncCall or Future::wait. Off by default.
+		** @param[in] target the thread; either its id, or an endpoint from getEndpoint.
+		** @param[in] bPumpingWaits TRUE to run incoming calls while waiting, FALSE to block.
+		** @remark
+		**   With pumping waits, two threads which call each other synchronously don't deadlock. In return,
+		**   calls can run in the middle of the thread's own code, which must be ready for that. Pumping waits
+		**   nest up to THREADSYNCH_MAX_PUMPING_DEPTH deep, after which they block. Calls made through an
+		**   endpoint from ThreadEndpoint::withoutPumping always block.
+		** @throw std::bad_alloc if the thread's mailbox could not be allocated.
+		*/
+		void setPumpingWaits(const ThreadEndpoint& target, BOOL bPumpingWaits);
+
+		/*! 
+		** @brief Creates the calling thread's mailbox up front, so that the first call scheduled to the
+		**        thread doesn't have to. Calling this is optional.
+		** @remark Thread ids are recycled, and a mailbox is kept for the lifetime of the scheduler, so the 
+		**   mailbox may be one left behind by an exited thread. It is reset: the calls queued in it are 
+		**   cancelled, and its settings return to their defaults. A thread which may have been given such
+		**   an id should register before calls are scheduled to it, or its mailbox configured.
+		** @throw std::bad_alloc if the mailbox could not be allocated.
+		*/
+		void registerCurrentThread();
+
+		/*! 
+		** @brief Resets the calling thread's mailbox as registerCurrentThread does, for a thread about to 
+		**        exit. Calls still queued for the thread are cancelled, which wakes their callers.
+		*/
+		void unregisterCurrentThread();
+
 	private:
 		/************************************************************************
 		** Types
 		*/ 
 		
-        typedef std::list<CallHandler*> CALLQUEUE;
-		typedef std::map<DWORD, CALLQUEUE> THREADCALLQUEUE;
+		typedef details::ThreadRegistry<details::Mailbox> MAILBOXREGISTRY;
 
 		/************************************************************************
 		** Variables
@@ -197,10 +583,10 @@ namespace ThreadSynch
 		static CallScheduler* m_pInstance;
 		static boost::mutex m_instanceMutex;
 		
-		// CallHandlers will not be deleted, and the queue will not be 
-		// affected outside a lock on this mutex
-		boost::mutex m_threadQueueMutex;
-		THREADCALLQUEUE m_threadQueue;
+		// Each target thread gets a mailbox the first time a call is scheduled to it, and keeps
+		// it for the lifetime of the scheduler. Lookups never lock. Calls which have not been
+		// picked up by the time the scheduler is destroyed are discarded.
+		MAILBOXREGISTRY m_mailboxes;
 
 		/************************************************************************
 		** Functions 
@@ -225,60 +611,183 @@ namespace ThreadSynch
 
         /*!
         ** @brief callback for asynchronous Future objects, which aborts a scheduled call
-        ** @param[in] dwThreadId the id of the thread the Asynchronous call will execute on
         ** @param[in] pCallHandler smart pointer to a CallHandler
         ** @remark If the call has already begun, this function will wait for it to end.
         ** @throw ... Any exceptions thrown during the execution of a started call will be thrown.
         */
-        ASYNCH_CALL_STATUS abortAsyncCall(DWORD dwThreadId, boost::shared_ptr<CallHandler> pCallHandler);
+        ASYNCH_CALL_STATUS abortAsyncCall(const boost::intrusive_ptr<CallHandler>& pCallHandler);
         
         /*!
         ** @brief callback for asynchronous Future objects, which causes the thread to wait for the started call to complete.
         ** @param[in] pCallHandler smart pointer to a CallHandler
         ** @param[in] dwTimeout the number of milliseconds to wait for the call to complete. Specify INFINITE to wait without timeouts.
+        ** @param[in] bPumpingAllowed whether or not the endpoint the call was made through allows a pumping wait.
         */
-        ASYNCH_CALL_STATUS waitAsyncCall(boost::shared_ptr<CallHandler> pCallHandler, DWORD dwTimeout);
+        ASYNCH_CALL_STATUS waitAsyncCall(const boost::intrusive_ptr<CallHandler>& pCallHandler, DWORD dwTimeout, BOOL bPumpingAllowed);
 
 		/*! 
 		** @brief adds a call to the specified therad's queue.
-		** @param[in] dwThreadId the id of the thread to enqueue in.
+		** @param[in] target the thread to enqueue in.
 		** @param[in] pCallHandler pointer to a CallHandler instance in which the details of the callback functor resides.
 		*/
-		void enqueueThreadCall(DWORD dwThreadId, CallHandler* pCallHandler);
+		void enqueueThreadCall(const ThreadEndpoint& target, CallHandler* pCallHandler, BOOL bDroppable);
 
 		/*! 
-		** @brief removes a call off a thread's queue.
-		** @param[in] dwThreadId the id of the thread to enqueue in.
-		** @param[in] pCallHandler pointer to a CallHandler instance in which the details of the callback functor resides.
+		** @brief adds a sequence of calls to the specified thread's queue, in one operation.
+		** @param[in] target the thread to enqueue in.
+		** @param[in] first, last a range of handlers, or of smart pointers to handlers.
+		** @param[in] bDroppable whether or not the calls may be dropped from a full queue. Only calls 
+		**            with a Future to report it are.
+		** @remark The target thread is notified at most once.
+		** @throw CallQueueFullException if the target thread's queue has no room for the calls.
 		*/
-		void dequeueThreadCall(DWORD dwThreadId, CallHandler* pCallHandler);
+		template<class Iterator>
+		void enqueueThreadCalls(const ThreadEndpoint& target, Iterator first, Iterator last, BOOL bDroppable);
 
 		/*! 
-		** @brief Function to fetch the next CallHandler off the specified queue.
-		** @param[in] dwThreadId the id of the thread to get a call for.
-		** @param[in] pCallHandlerLock a lock object, which has locked a resource in the CallHandler for simultaneous access.
-		** @return The next scheduled CallHandler.
+		** @return The status a Future reports for a call which was withdrawn before it could run.
 		*/
-        CallHandler* getNextCallFromQueue(DWORD dwThreadId, boost::scoped_ptr<boost::try_mutex::scoped_try_lock>& pCallHandlerLock);
+		static ASYNCH_CALL_STATUS getWithdrawnStatus(const CallHandler* pCallHandler);
 
-        /*!
-		** @brief Callback for CallHandler's rethrow mechanism
-		** @remark
-		**   Will be called by the throwHooked wrapper when a re-thrown exception has been destroyed.
-		**   The boost::shared_ptr will take care of deleting the CallHandler pointer.
-		*/    
-		static void onRethrownExceptionDestroyed(boost::shared_ptr<CallHandler> pCallHandler)
-		{ /* No actions */ }
+		/*! 
+		** @brief Finds the mailbox of a thread.
+		** @param[in] dwThreadId the id of the thread which owns the mailbox.
+		** @param[in] bCreate whether or not to create the mailbox if the thread doesn't have one yet.
+		** @return The mailbox, or NULL if bCreate is FALSE and the thread has no mailbox.
+		*/
+		details::Mailbox* getMailbox(ThreadId dwThreadId, BOOL bCreate);
+
+		/*! 
+		** @brief Finds the mailbox of an endpoint's thread, creating it if need be.
+		** @remark Endpoints resolved by this scheduler carry their mailbox, and are never looked up.
+		*/
+		details::Mailbox* getMailbox(const ThreadEndpoint& target);
+
+		/*! 
+		** @brief Finds the mailbox of the calling thread.
+		** @return The mailbox, or NULL if no calls have ever been scheduled to the calling thread.
+		** @remark Once found, the mailbox is remembered in thread local storage.
+		*/
+		details::Mailbox* getCurrentThreadMailbox();
+
+		/*! 
+		** @brief Executes the calls in a mailbox, within the mailbox's pickup budget. Used as the pickup 
+		**        callback, which is handed the mailbox of the thread it is executed in.
+		** @param[in] pMailbox the mailbox of the calling thread.
+		** @remark 
+		**   Only the calls found in the mailbox when the pickup starts are run. If a pickup has already been
+		**   rescheduled for calls left over by an earlier one, the calls are left for that pickup to run.
+		*/
+		static void APIENTRY executeMailboxCalls(details::Mailbox* pMailbox);
+
+		/*! 
+		** @brief The pickup callback scheduled for calls left over when a pickup runs out of budget.
+		** @param[in] pMailbox the mailbox of the calling thread.
+		*/
+		static void APIENTRY executeRearmedMailboxCalls(details::Mailbox* pMailbox);
+
+		/*! 
+		** @brief Runs the collected calls of a mailbox until they run out, or the pickup budget does. In the
+		**        latter case, another pickup is scheduled for the rest.
+		** @param[in] pMailbox the mailbox of the calling thread.
+		*/
+		static void executeCollectedCalls(details::Mailbox* pMailbox);
+
+		/*! 
+		** @brief Schedules another pickup for the calls left collected in a mailbox, unless one already is.
+		** @param[in] pMailbox the mailbox of the calling thread.
+		*/
+		static void rearmPickup(details::Mailbox* pMailbox);
+
+		/*! 
+		** @brief Shared by the pump flavors.
+		*/
+		size_t pumpCalls(std::chrono::steady_clock::duration timeout, size_t maxCalls);
+
+		/*! 
+		** @brief Finds the calling thread's mailbox, creating it if need be.
+		*/
+		details::Mailbox* getOrCreateCurrentThreadMailbox();
+
+		/*! 
+		** @brief Runs the collected calls of a mailbox, without a pickup budget.
+		** @param[in] pMailbox the mailbox of the calling thread.
+		** @param[in] maxCalls the number of calls to run at most, or 0 for no limit.
+		** @return The number of calls run.
+		*/
+		static size_t runCollectedCalls(details::Mailbox* pMailbox, size_t maxCalls);
+
+		/*! 
+		** @return The calling thread's mailbox, if the thread can pump its calls while it waits for a call
+		**   made through an endpoint which allows it, or NULL if the wait has to block.
+		*/
+		details::Mailbox* getPumpingMailbox(BOOL bPumpingAllowed);
+
+		/*! 
+		** @brief Waits for a call made by the calling thread. If the thread has pumping waits, it runs the
+		**        calls scheduled to it in the meantime.
+		** @param[in] pCallHandler the call.
+		** @param[in] bPumpingAllowed whether or not the endpoint the call was made through allows pumping.
+		** @param[in] timeout how long to wait, or duration::max() to wait without timeouts.
+		** @param[in] spin how long to spin before parking, if the wait doesn't pump.
+		** @return Whether or not the call completed or was withdrawn in time.
+		*/
+		BOOL waitForCall(CallHandler* pCallHandler, BOOL bPumpingAllowed, std::chrono::steady_clock::duration timeout, std::chrono::steady_clock::duration spin);
+
+		/*! 
+		** @brief Function to fetch the next CallHandler off the specified mailbox.
+		** @param[in] pMailbox the mailbox of the calling thread.
+		** @return The next scheduled CallHandler, claimed for execution, along with the reference the mailbox held on it.
+		*/
+        static CallHandler* getNextCallFromQueue(details::Mailbox* pMailbox);
 
         /*! 
         ** @brief Internal helper function shared between the different syncCall flavors
         */
-        void processSynchronousCallHandler(DWORD dwThreadId, CallHandler* pCallHandler, DWORD dwTimeout, boost::scoped_ptr<boost::try_mutex::scoped_lock>& pCallHandlerLock);
+        void processSynchronousCallHandler(const ThreadEndpoint& target, CallHandler* pCallHandler, std::chrono::steady_clock::duration timeout);
 
         /*! 
         ** @brief Internal helper function shared between the different asyncCall flavors
         */
-        void preProcessAsynchronousCallHandler(DWORD dwThreadId, CallHandler* pCallHandler);
+        void preProcessAsynchronousCallHandler(const ThreadEndpoint& target, CallHandler* pCallHandler);
+
+        /*! 
+        ** @brief Makes a synchronous call through a frame built by one of the syncCall flavors.
+        */
+        template<typename ReturnValueType>
+        ReturnValueType makeSyncCall(const ThreadEndpoint& target, const boost::intrusive_ptr<CallHandler>& pCallHandler, std::chrono::steady_clock::duration timeout);
+
+        /*! 
+        ** @brief Makes an asynchronous call through a frame built by one of the asyncCall flavors.
+        */
+        template<typename ReturnValueType>
+        Future<ReturnValueType> makeAsyncCall(const ThreadEndpoint& target, const boost::intrusive_ptr<CallHandler>& pCallHandler);
+
+        /*! 
+        ** @brief Creates the Future object of an asynchronous call.
+        */
+        template<typename ReturnValueType>
+        typename boost::disable_if<boost::is_void<ReturnValueType>, Future<ReturnValueType>>::
+        type makeFuture(const boost::intrusive_ptr<CallHandler>& pCallHandler, BOOL bPumpingAllowed);
+
+        template<typename ReturnValueType>
+        typename boost::enable_if<boost::is_void<ReturnValueType>, Future<ReturnValueType>>::
+        type makeFuture(const boost::intrusive_ptr<CallHandler>& pCallHandler, BOOL bPumpingAllowed);
+
+        /*! 
+        ** @brief Moves the return value out of a completed call.
+        */
+        template<typename ReturnValueType>
+        static typename boost::disable_if<boost::is_void<ReturnValueType>, ReturnValueType>::
+        type takeReturnValue(CallHandler* pCallHandler)
+        {
+            return std::move(pCallHandler->getReturnValue<ReturnValueType>());
+        }
+
+        template<typename ReturnValueType>
+        static typename boost::enable_if<boost::is_void<ReturnValueType>, ReturnValueType>::
+        type takeReturnValue(CallHandler* pCallHandler)
+        { /* void calls return nothing */ }
     };
 
 	/************************************************************************
@@ -303,126 +812,126 @@ namespace ThreadSynch
 		return m_pInstance;
 	}
 
-#pragma warning(push)
-#pragma warning(disable: 4715)
     template<class PickupPolicy>
     template<typename ReturnValueType, class Exceptions>
     typename boost::disable_if<IS_VOID_OR_SEQUENCE(ReturnValueType), ReturnValueType>::
-    type CallScheduler<PickupPolicy>::syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
+    type CallScheduler<PickupPolicy>::syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
     {
-		boost::shared_ptr<CallHandler> pCallHandler(new CallHandler());
-
-		// Initialize the container which holds the call to be done by the target thread
-		pCallHandler->setCallFunctor<ReturnValueType, Exceptions>(callback);
-
-        boost::scoped_ptr<boost::try_mutex::scoped_lock> pCallHandlerLock;
-		// Process the call handler, and add it to the queue
-		processSynchronousCallHandler(dwThreadId, pCallHandler.get(), dwTimeout, pCallHandlerLock);
-
-		// Check if the call completed, and if yes; store value.
-		if(pCallHandler->isCompleted())
-		{
-			if(pCallHandler->caughtException())
-			{
-				// Rethrow caught exceptions. This also leaves control of the pCallHandler pointer in the hands
-				// of the rethrow mechanism, and specifically onRethrownExceptionDestroyed, which will be called
-				// once the exception has been caught and destroyed.
-				pCallHandler->rethrowException(boost::bind(onRethrownExceptionDestroyed, pCallHandler));
-			}
-			else
-			{
-				return pCallHandler->getReturnValue<ReturnValueType>();
-			}
-		}
-		else
-		{
-			// Call function to lock queue (while callhandler is also locked) and then de-queue
-			dequeueThreadCall(dwThreadId, pCallHandler.get());
-            throw CallTimeoutException();
-		}
-	}
-#pragma warning(pop)
+        // Build the frame which holds the call to be done by the target thread
+        boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, boost::function<ReturnValueType()>>(std::move(callback)));
+        return makeSyncCall<ReturnValueType>(target, pCallHandler, details::toTimeout(dwTimeout));
+    }
 
     template<class PickupPolicy>
     template<typename ReturnValueType, class Exceptions>
     typename boost::enable_if<boost::is_void<ReturnValueType>, ReturnValueType>::
-    type CallScheduler<PickupPolicy>::syncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
-	{
-		boost::shared_ptr<CallHandler> pCallHandler(new CallHandler());
+    type CallScheduler<PickupPolicy>::syncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback, DWORD dwTimeout)
+    {
+        // Build the frame which holds the call to be done by the target thread
+        boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, boost::function<ReturnValueType()>>(std::move(callback)));
+        makeSyncCall<ReturnValueType>(target, pCallHandler, details::toTimeout(dwTimeout));
+    }
 
-		// Initialize the container which holds the call to be done by the target thread
-		pCallHandler->setCallFunctor<ReturnValueType, Exceptions>(callback);
+    template<class PickupPolicy>
+    template<typename ReturnValueType, class Exceptions>
+    typename boost::disable_if<IS_VOID_OR_SEQUENCE(ReturnValueType), Future<ReturnValueType>>::
+    type CallScheduler<PickupPolicy>::asyncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback)
+    {
+        // Build the frame which holds the call to be done by the target thread
+        boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, boost::function<ReturnValueType()>>(std::move(callback)));
+        return makeAsyncCall<ReturnValueType>(target, pCallHandler);
+    }
 
-        boost::scoped_ptr<boost::try_mutex::scoped_lock> pCallHandlerLock;
-		// Process the call handler, and add it to the queue
-		processSynchronousCallHandler(dwThreadId, pCallHandler.get(), dwTimeout, pCallHandlerLock);
+    template<class PickupPolicy>
+    template<typename ReturnValueType, class Exceptions>
+    typename boost::enable_if<boost::is_void<ReturnValueType>, Future<ReturnValueType>>::
+    type CallScheduler<PickupPolicy>::asyncCall(const ThreadEndpoint& target, boost::function<ReturnValueType()> callback)
+    {
+        // Build the frame which holds the call to be done by the target thread
+        boost::intrusive_ptr<CallHandler> pCallHandler(new details::CallFrame<ReturnValueType, Exceptions, boost::function<ReturnValueType()>>(std::move(callback)));
+        return makeAsyncCall<ReturnValueType>(target, pCallHandler);
+    }
+
+    template<class PickupPolicy>
+    template<typename ReturnValueType>
+    ReturnValueType CallScheduler<PickupPolicy>::makeSyncCall(const ThreadEndpoint& target, const boost::intrusive_ptr<CallHandler>& pCallHandler, std::chrono::steady_clock::duration timeout)
+    {
+        if(target.getThreadId() == details::getCurrentThreadId())
+        {
+            // A thread calling itself would only wait for itself, so the call is run right here, bypassing the
+            // mailbox. Nobody waits on the completion event, so setting it stays a plain memory operation. The
+            // frame still catches exceptions, so they reach the caller just as they would from another thread.
+            pCallHandler->claim();
+            pCallHandler->executeCallback();
+        }
+        else
+        {
+            // Process the call handler, and add it to the queue
+            processSynchronousCallHandler(target, pCallHandler.get(), timeout);
+        }
 
         // Check if the call completed, and if yes; store value.
         if(pCallHandler->isCompleted())
         {
             if(pCallHandler->caughtException())
             {
-                // Rethrow caught exceptions. This also leaves control of the pCallHandler pointer in the hands
-                // of the rethrow mechanism, and specifically onRethrownExceptionDestroyed, which will be called
-                // once the exception has been caught and destroyed.
-                pCallHandler->rethrowException(boost::bind(onRethrownExceptionDestroyed, pCallHandler));
+                // Rethrow caught exceptions. The exception object holds a reference to the handler, which keeps
+                // it alive until the exception has been caught and destroyed.
+                pCallHandler->rethrowException();
             }
             else
             {
-                return;
+                // The handler is the value's only owner, so it's moved, rather than copied, to the caller
+                return takeReturnValue<ReturnValueType>(pCallHandler.get());
             }
         }
         else
         {
-            // Call function to lock queue (while callhandler is also locked) and then de-queue
-            dequeueThreadCall(dwThreadId, pCallHandler.get());
+            // The call was cancelled before the target thread could claim it
             throw CallTimeoutException();
         }
-	}
+    }
 
     template<class PickupPolicy>
-    template<typename ReturnValueType, class Exceptions>
-    typename boost::disable_if<IS_VOID_OR_SEQUENCE(ReturnValueType), Future<ReturnValueType>>::
-    type CallScheduler<PickupPolicy>::asyncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback)
+    template<typename ReturnValueType>
+    Future<ReturnValueType> CallScheduler<PickupPolicy>::makeAsyncCall(const ThreadEndpoint& target, const boost::intrusive_ptr<CallHandler>& pCallHandler)
     {
-        boost::shared_ptr<CallHandler> pCallHandler(new CallHandler());
-
         // The Future construction can possibly throw (specifically a std::bad_alloc), so the construction must be done prior to
         // the CallHandler being added to the queue. Should an exception be thrown, pCallHandler will clean itself, and nothing
         // else will have gone wrong.
-        Future<ReturnValueType> futureObject = Future<ReturnValueType>(boost::bind(&CallScheduler<PickupPolicy>::abortAsyncCall, this, dwThreadId, pCallHandler),
-                                                                       boost::bind(&CallScheduler<PickupPolicy>::waitAsyncCall, this, pCallHandler, _1), 
-                                                                       boost::bind(&CallHandler::getReturnValue<ReturnValueType>, pCallHandler.get()));
-
-        // Initialize the container which holds the call to be done by the target thread
-        pCallHandler->setCallFunctor<ReturnValueType, Exceptions>(callback);
+        Future<ReturnValueType> futureObject = makeFuture<ReturnValueType>(pCallHandler, target.isPumpingAllowed());
 
         // Add the handler to the queue
-        preProcessAsynchronousCallHandler(dwThreadId, pCallHandler.get());
+        preProcessAsynchronousCallHandler(target, pCallHandler.get());
 
         return futureObject;
     }
 
     template<class PickupPolicy>
-    template<typename ReturnValueType, class Exceptions>
-    typename boost::enable_if<boost::is_void<ReturnValueType>, Future<ReturnValueType>>::
-    type CallScheduler<PickupPolicy>::asyncCall(DWORD dwThreadId, boost::function<ReturnValueType()> callback)
+    template<typename ReturnValueType>
+    typename boost::disable_if<boost::is_void<ReturnValueType>, Future<ReturnValueType>>::
+    type CallScheduler<PickupPolicy>::makeFuture(const boost::intrusive_ptr<CallHandler>& pCallHandler, BOOL bPumpingAllowed)
     {
-        boost::shared_ptr<CallHandler> pCallHandler(new CallHandler());
-
-        // The Future construction can possibly throw (specifically a std::bad_alloc), so the construction must be done prior to
-        // the CallHandler being added to the queue. Should an exception be thrown, pCallHandler will clean itself, and nothing
-        // else will have gone wrong.
-        Future<ReturnValueType> futureObject = Future<ReturnValueType>(boost::bind(&CallScheduler<PickupPolicy>::abortAsyncCall, this, dwThreadId, pCallHandler),
-                                                                       boost::bind(&CallScheduler<PickupPolicy>::waitAsyncCall, this, pCallHandler, _1));
-
-        // Initialize the container which holds the call to be done by the target thread
-        pCallHandler->setCallFunctor<ReturnValueType, Exceptions>(callback);
-
-        // Add the handler to the queue
-        preProcessAsynchronousCallHandler(dwThreadId, pCallHandler.get());
+        // The callbacks fit inline in the Future's functions, provided that they can be moved without throwing. A lambda
+        // capturing the const reference would hold a const pointer, which can only be copied, so a local copy is captured.
+        // The return value callback can hold a plain pointer, as the other two keep the handler alive. It hands out the 
+        // address of the value, which the Future then copies or moves out of the frame.
+        boost::intrusive_ptr<CallHandler> pHandler(pCallHandler);
+        CallHandler* pRawCallHandler = pCallHandler.get();
+        return Future<ReturnValueType>([this, pHandler]() { return abortAsyncCall(pHandler); },
+                                       [this, pHandler, bPumpingAllowed](DWORD dwTimeout) { return waitAsyncCall(pHandler, dwTimeout, bPumpingAllowed); },
+                                       [pRawCallHandler]() { return &pRawCallHandler->getReturnValue<ReturnValueType>(); });
+    }
 
-        return futureObject;
+    template<class PickupPolicy>
+    template<typename ReturnValueType>
+    typename boost::enable_if<boost::is_void<ReturnValueType>, Future<ReturnValueType>>::
+    type CallScheduler<PickupPolicy>::makeFuture(const boost::intrusive_ptr<CallHandler>& pCallHandler, BOOL bPumpingAllowed)
+    {
+        // The callbacks fit inline in the Future's functions. A local copy of the handler pointer is captured, as above.
+        boost::intrusive_ptr<CallHandler> pHandler(pCallHandler);
+        return Future<ReturnValueType>([this, pHandler]() { return abortAsyncCall(pHandler); },
+                                       [this, pHandler, bPumpingAllowed](DWORD dwTimeout) { return waitAsyncCall(pHandler, dwTimeout, bPumpingAllowed); });
     }
 
     template<class PickupPolicy>
@@ -431,24 +940,46 @@ namespace ThreadSynch
         /* Empty CTOR */
 	}
 
-#pragma warning(push)
-#pragma warning(disable: 4715)
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::registerCurrentThread()
+	{
+		getMailbox(details::getCurrentThreadId(), TRUE)->reset();
+	}
+
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::unregisterCurrentThread()
+	{
+		details::Mailbox* pMailbox = getMailbox(details::getCurrentThreadId(), FALSE);
+		if(pMailbox != NULL)
+		{
+			pMailbox->reset();
+		}
+	}
+
+	template<class PickupPolicy>
+	ThreadEndpoint CallScheduler<PickupPolicy>::getEndpoint(ThreadId dwThreadId)
+	{
+		return ThreadEndpoint(dwThreadId, getMailbox(dwThreadId, TRUE), this);
+	}
+
     template<class PickupPolicy>
-    ASYNCH_CALL_STATUS CallScheduler<PickupPolicy>::abortAsyncCall(DWORD dwThreadId, boost::shared_ptr<CallHandler> pCallHandler)
+    ASYNCH_CALL_STATUS CallScheduler<PickupPolicy>::abortAsyncCall(const boost::intrusive_ptr<CallHandler>& pCallHandler)
     {
-        boost::scoped_ptr<boost::try_mutex::scoped_lock> pCallHandlerLock;
-        // Attempt to obtain a lock on the CallHandler
-        pCallHandlerLock.reset(new boost::try_mutex::scoped_lock(*pCallHandler->getAccessMutex()));
+        // Cancel the call, unless the target thread has already claimed it. A claimed call is 
+        // always run to completion, so wait for it to end.
+        if(!pCallHandler->cancel() && !pCallHandler->isCancelled())
+        {
+            pCallHandler->waitForCompletion(INFINITE);
+        }
 
         // Check if the call completed, and if yes; store value.
         if(pCallHandler->isCompleted())
         {
             if(pCallHandler->caughtException())
             {
-                // Rethrow caught exceptions. This also leaves control of the pCallHandler pointer in the hands
-                // of the rethrow mechanism, and specifically onRethrownExceptionDestroyed, which will be called
-                // once the exception has been caught and destroyed.
-                pCallHandler->rethrowException(boost::bind(onRethrownExceptionDestroyed, pCallHandler));
+                // Rethrow caught exceptions. The exception object holds a reference to the handler, which keeps
+                // it alive until the exception has been caught and destroyed.
+                pCallHandler->rethrowException();
             }
             else
             {
@@ -457,18 +988,25 @@ namespace ThreadSynch
         }
         else
         {
-            // Call function to lock queue (while callhandler is also locked) and then de-queue
-            dequeueThreadCall(dwThreadId, pCallHandler.get());
-            return ASYNCH_CALL_ABORTED;
+            return getWithdrawnStatus(pCallHandler.get());
         }
     }
-#pragma warning(pop)
 
     template<class PickupPolicy>
-    ASYNCH_CALL_STATUS CallScheduler<PickupPolicy>::waitAsyncCall(boost::shared_ptr<CallHandler> pCallHandler, DWORD dwTimeout)
+    ASYNCH_CALL_STATUS CallScheduler<PickupPolicy>::waitAsyncCall(const boost::intrusive_ptr<CallHandler>& pCallHandler, DWORD dwTimeout, BOOL bPumpingAllowed)
     {
-        if(pCallHandler->waitForCompletion(dwTimeout))
+        // Polling the Future never runs other calls
+        BOOL bFinished = dwTimeout == 0 ? 
+                         pCallHandler->isFinished() : 
+                         waitForCall(pCallHandler.get(), bPumpingAllowed, details::toTimeout(dwTimeout), std::chrono::steady_clock::duration::zero());
+        if(bFinished)
         {
+            // A call cancelled by another copy of the Future, by the target thread past its deadline, by 
+            // a later coalesced call, or dropped from a full queue, sets the event too
+            if(pCallHandler->isCancelled())
+            {
+                return getWithdrawnStatus(pCallHandler.get());
+            }
             return ASYNCH_CALL_COMPLETE;
         }
         else
@@ -478,114 +1016,209 @@ namespace ThreadSynch
     }
 
 	template<class PickupPolicy>
-	void CallScheduler<PickupPolicy>::enqueueThreadCall(DWORD dwThreadId, CallHandler* pCallHandler)
+	void CallScheduler<PickupPolicy>::enqueueThreadCall(const ThreadEndpoint& target, CallHandler* pCallHandler, BOOL bDroppable)
 	{
-		// Acquire a lock on the thread queue
-		boost::mutex::scoped_lock lock(m_threadQueueMutex);
+		enqueueThreadCalls(target, &pCallHandler, &pCallHandler + 1, bDroppable);
+	}
 
-		// If there's no previously scheduled calls for that queue, we've got a schedule a pickup now
-		BOOL bMustQueueThreadPickup = (m_threadQueue.find(dwThreadId) == m_threadQueue.end());
+	template<class PickupPolicy>
+	template<class Iterator>
+	void CallScheduler<PickupPolicy>::enqueueThreadCalls(const ThreadEndpoint& target, Iterator first, Iterator last, BOOL bDroppable)
+	{
+		if(first == last)
+		{
+			return;
+		}
 
-		// Put the call onto the queue of calls waiting to happen
-		m_threadQueue[dwThreadId].push_back(pCallHandler);
+		details::Mailbox* pMailbox = getMailbox(target);
 
-		if(bMustQueueThreadPickup)
+		// A full mailbox applies its policy. The target thread itself can't wait for room, as only it makes room.
+		size_t count = std::distance(first, last);
+		if(!pMailbox->reserve(count) && 
+		   (target.getThreadId() == details::getCurrentThreadId() || !pMailbox->waitReserve(count)))
+		{
+			throw CallQueueFullException();
+		}
+		if(bDroppable)
 		{
 			try
 			{
-				PickupPolicy::scheduleThreadCallback(dwThreadId, 
-													 reinterpret_cast<PickupPolicyProvider::PCALLBACK>(&CallScheduler::executeScheduledCalls), 
-													 reinterpret_cast<ULONG_PTR>(this));
+				pMailbox->trackDroppable(first, last);
 			}
-			catch(PickupSchedulingFailedException&)
+			catch(...)
 			{
-				// Cleanup the thread queue. If this is left in place, there will be dead pointers there.
-				m_threadQueue.erase(dwThreadId);
+				pMailbox->release(count);
+				throw;
+			}
+		}
 
-				// Todo: update the message thrown to something reported by the policy
-				throw CallSchedulingFailedException("PickupPolicyProvider reported a failure");
+		// The mailbox holds a reference to each call until the target thread has dealt with it
+		for(Iterator it = first; it != last; ++it)
+		{
+			intrusive_ptr_add_ref(&**it);
+		}
+
+		if(target.getDeadline() != INFINITE)
+		{
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(target.getDeadline());
+			for(Iterator it = first; it != last; ++it)
+			{
+				(*it)->setDeadline(deadline);
+			}
+		}
+
+		// Unless the thread has already been notified since it last collected its calls, schedule a pickup now.
+		// A thread in a pumping wait is woken either way, as it runs its calls without a pickup.
+		BOOL bNotify = pMailbox->pushAll(first, last, target.getPriority());
+		pMailbox->wakePumpingOwner();
+		if(bNotify)
+		{
+			try
+			{
+				PickupPolicy::scheduleThreadCallback(target.getThreadId(), 
+													 reinterpret_cast<PickupPolicyProvider::PCALLBACK>(&CallScheduler::executeMailboxCalls), 
+													 reinterpret_cast<ULONG_PTR>(pMailbox));
 			}
 			catch(...)
 			{
-				// Cleanup the thread queue. If this is left in place, there will be dead pointers there.
-				m_threadQueue.erase(dwThreadId);
+				// Withdraw the calls, unless the thread has collected and claimed them already. Dropped calls give
+				// their room back right away, and are skipped if the thread ever collects them. Calls pushed by
+				// other producers are left queued, and the next call to the thread schedules a pickup again.
+				for(Iterator it = first; it != last; ++it)
+				{
+					if((*it)->drop())
+					{
+						pMailbox->release(1);
+					}
+				}
+				pMailbox->clearNotified();
 
-				// Catch all other exceptions and throw a generic message
 				throw CallSchedulingFailedException("PickupPolicyProvider reported a failure");
 			}
 		}
 	}
 
 	template<class PickupPolicy>
-	void CallScheduler<PickupPolicy>::dequeueThreadCall(DWORD dwThreadId, CallHandler* pCallHandler)
+	void CallScheduler<PickupPolicy>::setPickupBudget(const ThreadEndpoint& target, size_t maxCalls, DWORD dwMaxMicroseconds)
 	{
-		boost::mutex::scoped_lock lock(m_threadQueueMutex);
-		
-		THREADCALLQUEUE::iterator threadQueueIter = m_threadQueue.find(dwThreadId);
-		if(threadQueueIter == m_threadQueue.end())
-		{
-			// No queue for that thread id, so bail.
-			return;
-		}
+		getMailbox(target)->setPickupBudget(maxCalls, dwMaxMicroseconds);
+	}
+
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::setDeadlineOrdering(const ThreadEndpoint& target, BOOL bDeadlineOrdering)
+	{
+		getMailbox(target)->setDeadlineOrdering(bDeadlineOrdering);
+	}
+
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::setQueueCapacity(const ThreadEndpoint& target, size_t capacity, QUEUE_FULL_POLICY policy, DWORD dwTimeout)
+	{
+		getMailbox(target)->setCapacity(capacity, policy, dwTimeout);
+	}
+
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::setQueueWatermarks(const ThreadEndpoint& target, size_t highWatermark, size_t lowWatermark, const boost::function<void (BOOL bAboveHighWatermark)>& callback)
+	{
+		getMailbox(target)->setWatermarks(highWatermark, lowWatermark, callback);
+	}
+
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::setPumpingWaits(const ThreadEndpoint& target, BOOL bPumpingWaits)
+	{
+		getMailbox(target)->setPumpingWaits(bPumpingWaits);
+	}
+
+	template<class PickupPolicy>
+	size_t CallScheduler<PickupPolicy>::getQueueDepth(const ThreadEndpoint& target)
+	{
+		return getMailbox(target)->getQueuedCount();
+	}
 
-		CALLQUEUE::iterator callQueueIter = std::find((*threadQueueIter).second.begin(), (*threadQueueIter).second.end(), pCallHandler);
-		if(callQueueIter == (*threadQueueIter).second.end())
+	template<class PickupPolicy>
+	ASYNCH_CALL_STATUS CallScheduler<PickupPolicy>::getWithdrawnStatus(const CallHandler* pCallHandler)
+	{
+		if(pCallHandler->isSuperseded())
 		{
-			// The callback was not found in the thread's queue
-			return;
+			return ASYNCH_CALL_SUPERSEDED;
 		}
-		
-        // Delete the thread's queue
-		(*threadQueueIter).second.erase(callQueueIter);
+		return pCallHandler->isDropped() ? ASYNCH_CALL_DROPPED : ASYNCH_CALL_ABORTED;
+	}
 
-        // If the threads queue is now empty; delete it
-        if((*threadQueueIter).second.empty())
-        {
-            m_threadQueue.erase(threadQueueIter);
-        }
+	template<class PickupPolicy>
+	details::Mailbox* CallScheduler<PickupPolicy>::getMailbox(ThreadId dwThreadId, BOOL bCreate)
+	{
+		return bCreate ? m_mailboxes.findOrCreate(dwThreadId) : m_mailboxes.find(dwThreadId);
 	}
 
 	template<class PickupPolicy>
-    CallHandler* CallScheduler<PickupPolicy>::getNextCallFromQueue(DWORD dwThreadId, boost::scoped_ptr<boost::try_mutex::scoped_try_lock>& pCallHandlerLock)
+	details::Mailbox* CallScheduler<PickupPolicy>::getMailbox(const ThreadEndpoint& target)
 	{
-		// Acquire a lock on the thread queue
-		boost::mutex::scoped_lock lock(m_threadQueueMutex);
-		THREADCALLQUEUE::iterator threadQueueIter;
+		if(target.m_pMailbox != NULL && target.m_pOwner == this)
+		{
+			return target.m_pMailbox;
+		}
+		return getMailbox(target.getThreadId(), TRUE);
+	}
 
-		if((threadQueueIter = m_threadQueue.find(dwThreadId)) != m_threadQueue.end())
+	template<class PickupPolicy>
+	details::Mailbox* CallScheduler<PickupPolicy>::getCurrentThreadMailbox()
+	{
+		// Only a successful lookup is remembered, as the mailbox may be created later on
+		static thread_local details::Mailbox* pCurrentThreadMailbox = NULL;
+		if(pCurrentThreadMailbox == NULL)
 		{
-			// Find the queue for the current requested thread
-			CALLQUEUE* pCallbackQueue = &((*threadQueueIter).second);
+			pCurrentThreadMailbox = getMailbox(details::getCurrentThreadId(), FALSE);
+		}
+		return pCurrentThreadMailbox;
+	}
 
-            CALLQUEUE::iterator callbackQueueIterator;
-            for(callbackQueueIterator = pCallbackQueue->begin(); callbackQueueIterator != pCallbackQueue->end(); ++ callbackQueueIterator)
+	template<class PickupPolicy>
+    CallHandler* CallScheduler<PickupPolicy>::getNextCallFromQueue(details::Mailbox* pMailbox)
+	{
+		CallHandler* pCallHandler;
+		while((pCallHandler = pMailbox->popCollected()) != NULL)
+		{
+			// A coalesced call holds its key's place in the queue. Run the latest call with the key in its place.
+			CallHandler* pPlace = pCallHandler;
+			if(pCallHandler->isCoalesced())
 			{
-                CallHandler* pCallHandler = *callbackQueueIterator;
-				
-				// Try to acquire a lock on the call handler, to prevent the scheduler from deallocating it
-				// while the function is running. While this lock is in place, the syncCall cannot
-				// destroy the CallHandler.
-				pCallHandlerLock.reset(new boost::try_mutex::scoped_try_lock(*pCallHandler->getAccessMutex(), false));
-                if(!pCallHandlerLock->try_lock())
-                {
-                    // We didn't get a lock on the CallHandler. This means that it's taken, and should not be parsed at this time.
-                    // Continue with the next queued item.
-                    pCallHandlerLock.reset();
-                    continue;
-                }
-
-                // The lock was obtained, so we can pop it off the queue
-				pCallbackQueue->pop_front();
-				
-				// If this was the last item in the queues thread ..
-				if(pCallbackQueue->empty())
+				CallHandler* pLatest = pMailbox->detachCoalesced(pCallHandler);
+				if(pLatest != NULL)
 				{
-					// Erase the thread's queue
-					m_threadQueue.erase(threadQueueIter);
+					pCallHandler->supersede();
+					pCallHandler = pLatest;
 				}
+			}
+
+			// A call past its deadline is no longer wanted, so cancel it rather than run it. Only calls
+			// with a deadline read the clock.
+			BOOL bClaimed = FALSE;
+			if(!pCallHandler->hasDeadline() || 
+			   std::chrono::steady_clock::now() < pCallHandler->getDeadline() ||
+			   !pCallHandler->cancel())
+			{
+				// Claiming the call races with the caller cancelling it. Once claimed, the call can no
+				// longer be cancelled, and the caller will wait for it to complete.
+				bClaimed = pCallHandler->claim();
+			}
 
+			// The place's state is final by now. A place dropped by a producer has already given up its room.
+			if(!pPlace->isDropped())
+			{
+				pMailbox->release(1);
+			}
+			if(pPlace != pCallHandler)
+			{
+				intrusive_ptr_release(pPlace);
+			}
+			if(bClaimed)
+			{
 				return pCallHandler;
 			}
+
+			// The call was cancelled after a timeout, an abort or its deadline. It must not run, so drop 
+			// the mailbox's reference and move on.
+			intrusive_ptr_release(pCallHandler);
 		}
 		return NULL;
 	}
@@ -593,55 +1226,379 @@ namespace ThreadSynch
 	template<class PickupPolicy>
 	void APIENTRY CallScheduler<PickupPolicy>::executeScheduledCalls(CallScheduler* pSchedulerInstance)
 	{
-		DWORD dwThreadId = GetCurrentThreadId();
+		details::Mailbox* pMailbox = pSchedulerInstance->getCurrentThreadMailbox();
+		if(pMailbox != NULL)
+		{
+			pMailbox->setPickupRearmed(FALSE);
+			pMailbox->collect();
+			executeCollectedCalls(pMailbox);
+		}
+	}
+
+	template<class PickupPolicy>
+	size_t CallScheduler<PickupPolicy>::pump(DWORD dwTimeout, size_t maxCalls)
+	{
+		return pumpCalls(details::toTimeout(dwTimeout), maxCalls);
+	}
+
+	template<class PickupPolicy>
+	size_t CallScheduler<PickupPolicy>::poll(size_t maxCalls)
+	{
+		details::Mailbox* pMailbox = getOrCreateCurrentThreadMailbox();
+		if(!pMailbox->hasCollected() && !pMailbox->hasPushed())
+		{
+			return 0;
+		}
+
+		// Like the pump, the poll stands in for any pickup
+		pMailbox->setPickupRearmed(FALSE);
+		pMailbox->collect();
+		return runCollectedCalls(pMailbox, maxCalls);
+	}
+
+	template<class PickupPolicy>
+	size_t CallScheduler<PickupPolicy>::pumpCalls(std::chrono::steady_clock::duration timeout, size_t maxCalls)
+	{
+		details::Mailbox* pMailbox = getOrCreateCurrentThreadMailbox();
+
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+		if(timeout != std::chrono::steady_clock::duration::max())
+		{
+			deadline = std::chrono::steady_clock::now() + timeout;
+		}
+
+		// The pump stands in for any pickup, including one rescheduled for calls left over by an earlier pickup
+		pMailbox->setPickupRearmed(FALSE);
+
+		details::CompletionEvent& pumpEvent = pMailbox->getPumpEvent();
+		size_t callCount = 0;
+		pMailbox->enterPumping();
+		try
+		{
+			for(;;)
+			{
+				// Producers set the event after they push, so a push made before the reset is collected below
+				pumpEvent.reset();
+				pMailbox->collect();
+				callCount = runCollectedCalls(pMailbox, maxCalls);
+				if(callCount != 0)
+				{
+					break;
+				}
+
+				std::chrono::steady_clock::duration remaining = std::chrono::steady_clock::duration::max();
+				if(deadline != std::chrono::steady_clock::time_point::max())
+				{
+					remaining = deadline - std::chrono::steady_clock::now();
+					if(remaining <= std::chrono::steady_clock::duration::zero())
+					{
+						break;
+					}
+				}
+				pumpEvent.wait(remaining, std::chrono::steady_clock::duration::zero());
+			}
+		}
+		catch(...)
+		{
+			pMailbox->leavePumping();
+			throw;
+		}
+		pMailbox->leavePumping();
+		return callCount;
+	}
+
+	template<class PickupPolicy>
+	details::Mailbox* CallScheduler<PickupPolicy>::getOrCreateCurrentThreadMailbox()
+	{
+		details::Mailbox* pMailbox = getCurrentThreadMailbox();
+		return pMailbox != NULL ? pMailbox : getMailbox(details::getCurrentThreadId(), TRUE);
+	}
+
+	template<class PickupPolicy>
+	size_t CallScheduler<PickupPolicy>::runCollectedCalls(details::Mailbox* pMailbox, size_t maxCalls)
+	{
+		size_t callCount = 0;
+		CallHandler* pCallHandler;
+		while((maxCalls == 0 || callCount < maxCalls) && (pCallHandler = getNextCallFromQueue(pMailbox)) != NULL)
+		{
+			pCallHandler->executeCallback();
+
+			// Once the mailbox's reference is released, pCallHandler isn't guaranteed to be valid anymore
+			intrusive_ptr_release(pCallHandler);
+			++callCount;
+		}
+		return callCount;
+	}
+
+	template<class PickupPolicy>
+	void APIENTRY CallScheduler<PickupPolicy>::executeMailboxCalls(details::Mailbox* pMailbox)
+	{
+		// Only the calls scheduled so far are run. Calls scheduled from here on get a pickup of their own.
+		pMailbox->collect();
+
+		// Running the calls here, as well as in the rescheduled pickup, would spend the budget twice in one go
+		if(!pMailbox->isPickupRearmed())
+		{
+			executeCollectedCalls(pMailbox);
+		}
+	}
+
+	template<class PickupPolicy>
+	void APIENTRY CallScheduler<PickupPolicy>::executeRearmedMailboxCalls(details::Mailbox* pMailbox)
+	{
+		pMailbox->setPickupRearmed(FALSE);
+		pMailbox->collect();
+		executeCollectedCalls(pMailbox);
+	}
+
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::executeCollectedCalls(details::Mailbox* pMailbox)
+	{
         CallHandler* pCallHandler;
-        boost::scoped_ptr<boost::try_mutex::scoped_try_lock> pCallHandlerLock;
 
-		while((pCallHandler = pSchedulerInstance->getNextCallFromQueue(dwThreadId, pCallHandlerLock)) != NULL)
+		// The budget is read once per pickup. The clock is only read if there's a time limit.
+		size_t maxCalls = pMailbox->getMaxCallsPerPickup();
+		DWORD dwMaxMicroseconds = pMailbox->getMaxMicrosecondsPerPickup();
+		std::chrono::steady_clock::time_point deadline;
+		if(dwMaxMicroseconds != 0)
+		{
+			deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(dwMaxMicroseconds);
+		}
+
+		size_t callCount = 0;
+		while((pCallHandler = getNextCallFromQueue(pMailbox)) != NULL)
 		{
-			// A call handler has been checked out of the structure
+			// A call handler has been claimed from the structure
 			pCallHandler->executeCallback();
 
-			// Once this lock is reset, pCallHandler isn't guaranteed to be valid anymore
-			pCallHandlerLock.reset();
+			// Once the mailbox's reference is released, pCallHandler isn't guaranteed to be valid anymore
+			intrusive_ptr_release(pCallHandler);
+
+			++callCount;
+			if((maxCalls != 0 && callCount >= maxCalls) ||
+			   (dwMaxMicroseconds != 0 && std::chrono::steady_clock::now() >= deadline))
+			{
+				break;
+			}
+		}
+
+		rearmPickup(pMailbox);
+	}
+
+	template<class PickupPolicy>
+	void CallScheduler<PickupPolicy>::rearmPickup(details::Mailbox* pMailbox)
+	{
+		// Producers only notify the thread when they find the mailbox empty, so the calls left over 
+		// need a pickup of their own. One is enough.
+		if(!pMailbox->hasCollected() || pMailbox->isPickupRearmed())
+		{
+			return;
+		}
+
+		CallHandler* pCallHandler;
+		try
+		{
+			// Addressed to the mailbox's owner, which isn't the calling thread for targets that aren't threads
+			PickupPolicy::scheduleThreadCallback(pMailbox->getOwnerThreadId(), 
+												 reinterpret_cast<PickupPolicyProvider::PCALLBACK>(&CallScheduler::executeRearmedMailboxCalls), 
+												 reinterpret_cast<ULONG_PTR>(pMailbox));
+			pMailbox->setPickupRearmed(TRUE);
+		}
+		catch(...)
+		{
+			// Without another pickup, the calls left over would be stranded. Run them now instead.
+			while((pCallHandler = getNextCallFromQueue(pMailbox)) != NULL)
+			{
+				pCallHandler->executeCallback();
+				intrusive_ptr_release(pCallHandler);
+			}
 		}
 	}
 
     template<class PickupPolicy>
-    void CallScheduler<PickupPolicy>::processSynchronousCallHandler(DWORD dwThreadId, CallHandler* pCallHandler, DWORD dwTimeout, boost::scoped_ptr<boost::try_mutex::scoped_lock>& pCallHandlerLock)
+    void CallScheduler<PickupPolicy>::processSynchronousCallHandler(const ThreadEndpoint& target, CallHandler* pCallHandler, std::chrono::steady_clock::duration timeout)
     {
+        // The clock is only read for a timeout, or to tune the spin
+        BOOL bSpin = details::AdaptiveSpin::isEnabled();
+        std::chrono::steady_clock::time_point start;
+        if(bSpin || timeout != std::chrono::steady_clock::duration::max())
+        {
+            start = std::chrono::steady_clock::now();
+        }
+
+        // The target thread discards the call, rather than run it, once the caller has given up on it
+        if(timeout != std::chrono::steady_clock::duration::max())
+        {
+            pCallHandler->setDeadline(start + timeout);
+        }
+
+        // A thread which blocks on a thread that is blocked on it in turn would only time out, so the call
+        // fails right away instead. Pumping waits can't deadlock, and aren't recorded.
+        details::Mailbox* pCallerMailbox = NULL;
+        details::Mailbox* pPreviousTarget = NULL;
+        if(target.isDeadlockDetectionEnabled() && getPumpingMailbox(target.isPumpingAllowed()) == NULL)
+        {
+            pCallerMailbox = getOrCreateCurrentThreadMailbox();
+            pPreviousTarget = pCallerMailbox->setWaitingFor(getMailbox(target));
+            if(pCallerMailbox->isWaitCycle())
+            {
+                pCallerMailbox->setWaitingFor(pPreviousTarget);
+                throw CallDeadlockException();
+            }
+        }
+
         try
         {
             // Enqueue the call and notify the pickup policy
-            enqueueThreadCall(dwThreadId, pCallHandler);
+            enqueueThreadCall(target, pCallHandler, FALSE);
+
+            // Calls which usually complete within microseconds are spun on, rather than parked for
+            details::AdaptiveSpin* pSpin = NULL;
+            std::chrono::steady_clock::duration spin = std::chrono::steady_clock::duration::zero();
+            if(bSpin)
+            {
+                pSpin = &getMailbox(target)->getSyncSpin();
+                spin = pSpin->getSpin();
+            }
+
+            // On timeout, race the target thread for the call. If the call has already been claimed,
+            // it is running, and the cancellation must wait for it to complete. That wait pumps too, as
+            // the call may be waiting for this thread in turn.
+            if(!waitForCall(pCallHandler, target.isPumpingAllowed(), timeout, spin) && !pCallHandler->cancel())
+            {
+                waitForCall(pCallHandler, target.isPumpingAllowed(), std::chrono::steady_clock::duration::max(), std::chrono::steady_clock::duration::zero());
+            }
+            if(pSpin != NULL && pCallHandler->isCompleted())
+            {
+                pSpin->record(std::chrono::steady_clock::now() - start);
+            }
         }
-        catch(CallSchedulingFailedException&)
+        catch(...)
         {
+            if(pCallerMailbox != NULL)
+            {
+                pCallerMailbox->setWaitingFor(pPreviousTarget);
+            }
             throw;
         }
+        if(pCallerMailbox != NULL)
+        {
+            pCallerMailbox->setWaitingFor(pPreviousTarget);
+        }
+    }
 
-        pCallHandler->waitForCompletion(dwTimeout);
-
-        // Before pCallHandler is deleted, a lock on both the handler mutex and the queue mutex must be in place
-        // only upon the two in place can the handler be deleted
-
-        // Obtain a lock on the access handler, preventing the scheduler to open it if the call
-        // has not yet been begun. If the callback sequence has been set in motion, this lock will
-        // wait until it has completed.
-        pCallHandlerLock.reset(new boost::try_mutex::scoped_lock(*pCallHandler->getAccessMutex()));
+    template<class PickupPolicy>
+    details::Mailbox* CallScheduler<PickupPolicy>::getPumpingMailbox(BOOL bPumpingAllowed)
+    {
+        details::Mailbox* pMailbox = bPumpingAllowed ? getCurrentThreadMailbox() : NULL;
+        return pMailbox != NULL && pMailbox->canPump() ? pMailbox : NULL;
     }
 
     template<class PickupPolicy>
-    void CallScheduler<PickupPolicy>::preProcessAsynchronousCallHandler(DWORD dwThreadId, CallHandler* pCallHandler)
+    BOOL CallScheduler<PickupPolicy>::waitForCall(CallHandler* pCallHandler, BOOL bPumpingAllowed, std::chrono::steady_clock::duration timeout, std::chrono::steady_clock::duration spin)
     {
+        // Only one thread can pump for a call. Other waiters, such as copies of its Future on other threads, block.
+        details::Mailbox* pMailbox = getPumpingMailbox(bPumpingAllowed);
+        if(pMailbox == NULL || !pCallHandler->watchCompletion(&pMailbox->getPumpEvent()))
+        {
+            return pCallHandler->waitForCompletion(timeout, spin);
+        }
+
+        // A pumping wait doesn't spin, as it may well have calls of its own to run
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        if(timeout != std::chrono::steady_clock::duration::max())
+        {
+            deadline = std::chrono::steady_clock::now() + timeout;
+        }
+
+        details::CompletionEvent& pumpEvent = pMailbox->getPumpEvent();
+        BOOL bFinished = FALSE;
+        pMailbox->enterPumping();
         try
         {
-            // Enqueue the call and notify the pickup policy
-            enqueueThreadCall(dwThreadId, pCallHandler);
+            for(;;)
+            {
+                // Both the call and producers set the event after they're done, so anything which happened 
+                // before the event was reset is seen below
+                pumpEvent.reset();
+                if(pCallHandler->isFinished())
+                {
+                    bFinished = TRUE;
+                    break;
+                }
+
+                // The calls run one at a time, so that the wait returns as soon as its call is done
+                pMailbox->collect();
+                CallHandler* pIncoming;
+                while(!pCallHandler->isFinished() && (pIncoming = getNextCallFromQueue(pMailbox)) != NULL)
+                {
+                    pIncoming->executeCallback();
+                    intrusive_ptr_release(pIncoming);
+                }
+                if(pCallHandler->isFinished())
+                {
+                    bFinished = TRUE;
+                    break;
+                }
+
+                std::chrono::steady_clock::duration remaining = std::chrono::steady_clock::duration::max();
+                if(deadline != std::chrono::steady_clock::time_point::max())
+                {
+                    remaining = deadline - std::chrono::steady_clock::now();
+                    if(remaining <= std::chrono::steady_clock::duration::zero())
+                    {
+                        break;
+                    }
+                }
+                pumpEvent.wait(remaining, std::chrono::steady_clock::duration::zero());
+            }
         }
-        catch(CallSchedulingFailedException&)
+        catch(...)
         {
+            pMailbox->leavePumping();
+            pCallHandler->unwatchCompletion();
             throw;
         }
+        pMailbox->leavePumping();
+        pCallHandler->unwatchCompletion();
+
+        // Calls collected, but not run, before the call completed are left to a pickup
+        rearmPickup(pMailbox);
+        return bFinished;
+    }
+
+    template<class PickupPolicy>
+    void CallScheduler<PickupPolicy>::preProcessAsynchronousCallHandler(const ThreadEndpoint& target, CallHandler* pCallHandler)
+    {
+        // A coalesced call is attached to the queued call with its key, if there is one. Otherwise 
+        // it is queued like any other call.
+        if(pCallHandler->isCoalesced())
+        {
+            details::Mailbox* pMailbox = getMailbox(target);
+            if(target.getDeadline() != INFINITE)
+            {
+                pCallHandler->setDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(target.getDeadline()));
+            }
+            if(pMailbox->attachCoalesced(pCallHandler))
+            {
+                return;
+            }
+
+            // The call holds its key's place from here on. Should it fail to be queued, say to a full mailbox,
+            // the place must be given up again, or later calls with the key would be attached to a dead one.
+            try
+            {
+                enqueueThreadCall(target, pCallHandler, TRUE);
+            }
+            catch(...)
+            {
+                pMailbox->abandonCoalesced(pCallHandler);
+                throw;
+            }
+            return;
+        }
+
+        // Enqueue the call and notify the pickup policy
+        enqueueThreadCall(target, pCallHandler, TRUE);
     }
 }
\ No newline at end of file
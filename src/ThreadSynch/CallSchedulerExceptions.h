@@ -31,10 +31,33 @@ namespace ThreadSynch
 	{
 	public:
 		CallSchedulingFailedException()
+			: m_what("CallSchedulingFailedException")
 		{}
 
 		CallSchedulingFailedException(const char *const& _What)
-			: std::exception(_What)
+			: m_what(_What)
+		{}
+
+		virtual const char* what() const throw()
+		{ return m_what; }
+
+	private:
+		const char* m_what;
+	};
+
+	/*!@class CallQueueFullException
+	** @brief thrown when a call can't be scheduled because the target thread's queue is at capacity.
+	** @sa CallScheduler::setQueueCapacity
+	*/
+	class CallQueueFullException : public CallSchedulingFailedException
+	{
+	public:
+		CallQueueFullException()
+			: CallSchedulingFailedException("CallQueueFullException")
+		{}
+
+		CallQueueFullException(const char *const& _What)
+			: CallSchedulingFailedException(_What)
 		{}
 	};
 
@@ -45,10 +68,35 @@ namespace ThreadSynch
 	{
 	public:
 		CallTimeoutException()
+			: m_what("CallTimeoutException")
 		{}
 
 		CallTimeoutException(const char *const& _What)
-			: std::exception(_What)
+			: m_what(_What)
+		{}
+
+		virtual const char* what() const throw()
+		{ return m_what; }
+
+	private:
+		const char* m_what;
+	};
+
+	/*!@class CallDeadlockException
+	** @brief thrown instead of waiting for a synchronous call, when the target thread is blocked on a
+	**   call to the calling thread, directly or through other threads. The call is never scheduled.
+	** @remark Derives from CallTimeoutException, which is what the call would otherwise have ended in.
+	** @sa ThreadEndpoint::withoutDeadlockDetection
+	*/
+	class CallDeadlockException : public CallTimeoutException
+	{
+	public:
+		CallDeadlockException()
+			: CallTimeoutException("CallDeadlockException")
+		{}
+
+		CallDeadlockException(const char *const& _What)
+			: CallTimeoutException(_What)
 		{}
 	};
 
@@ -0,0 +1,276 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <climits>
+#endif
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+#ifndef __linux__
+        /*!@class ParkingLot
+        ** @brief A fixed set of mutex and condition variable pairs, shared by every CompletionEvent.
+        ** @remark
+        **   Events hash their address to a stripe, so no event ever owns a kernel object of its own.
+        **   The lot is intentionally never destroyed, as waiters may outlive static destruction.
+        */
+        class ParkingLot : private boost::noncopyable
+        {
+        public:
+            struct Stripe
+            {
+                std::mutex mutex;
+                std::condition_variable condition;
+                char padding[THREADSYNCH_CACHE_LINE_SIZE];
+            };
+
+            static Stripe& getStripe(const void* pAddress)
+            {
+                static ParkingLot* pLot = new ParkingLot();
+                return pLot->m_stripes[(reinterpret_cast<ULONG_PTR>(pAddress) / sizeof(void*)) % THREADSYNCH_PARKING_LOT_SIZE];
+            }
+
+        private:
+            Stripe m_stripes[THREADSYNCH_PARKING_LOT_SIZE];
+        };
+#endif
+
+        /*!
+        ** @brief Converts a Win32 style timeout in milliseconds to the clock's own, where duration::max()
+        **        waits without timeouts.
+        */
+        inline std::chrono::steady_clock::duration toTimeout(DWORD dwTimeout)
+        {
+            if(dwTimeout == INFINITE)
+            {
+                return std::chrono::steady_clock::duration::max();
+            }
+            return std::chrono::milliseconds(dwTimeout);
+        }
+
+        /*!
+        ** @brief Converts a timeout of any precision to the clock's own, where duration::max() waits 
+        **        without timeouts.
+        ** @remark Negative timeouts don't wait, and timeouts too long to represent are infinite.
+        */
+        template<class Rep, class Period>
+        inline std::chrono::steady_clock::duration toTimeout(const std::chrono::duration<Rep, Period>& timeout)
+        {
+            if(timeout <= std::chrono::duration<Rep, Period>::zero())
+            {
+                return std::chrono::steady_clock::duration::zero();
+            }
+            if(std::chrono::duration<double>(timeout) >= std::chrono::duration<double>(std::chrono::steady_clock::duration::max()))
+            {
+                return std::chrono::steady_clock::duration::max();
+            }
+            return std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+        }
+
+        /*!@class CompletionEvent
+        ** @brief A manual reset event, signaled once a scheduled call has completed.
+        ** @remark
+        **   The event is a single atomic word. Checking or setting an event nobody waits on is a plain
+        **   memory operation, and no kernel object is created per event. Waiters park on a futex on
+        **   Linux, and on a stripe of the shared ParkingLot elsewhere.
+        */
+        class CompletionEvent : private boost::noncopyable
+        {
+        public:
+            CompletionEvent()
+                : m_state(STATE_UNSIGNALED)
+            {}
+
+            /*!
+            ** @brief Signals the event, releasing all current and future waiters.
+            */
+            void set()
+            {
+                // Sequentially consistent, so that a thread which starts watching the event for a pumping
+                // wait either sees it set, or is seen by the setter
+                if(m_state.exchange(STATE_SIGNALED, std::memory_order_seq_cst) == STATE_WAITING)
+                {
+                    wakeAll();
+                }
+            }
+
+            /*!
+            ** @brief Waits for the event to be signaled.
+            ** @param[in] dwTimeout number of milliseconds to wait. Specify INFINITE to wait without timeouts.
+            ** @retval TRUE the event was signaled.
+            ** @retval FALSE the wait timed out.
+            */
+            BOOL wait(DWORD dwTimeout) const
+            {
+                return wait(toTimeout(dwTimeout), std::chrono::steady_clock::duration::zero());
+            }
+
+            /*!
+            ** @brief Waits for the event to be signaled, spinning for a while before parking.
+            ** @param[in] timeout how long to wait, or duration::max() to wait without timeouts.
+            ** @param[in] spin how long to spin before parking. Spinning counts towards the timeout.
+            ** @retval TRUE the event was signaled.
+            ** @retval FALSE the wait timed out.
+            */
+            BOOL wait(std::chrono::steady_clock::duration timeout, std::chrono::steady_clock::duration spin) const
+            {
+                if(isSet())
+                {
+                    return TRUE;
+                }
+                if(timeout <= std::chrono::steady_clock::duration::zero())
+                {
+                    return FALSE;
+                }
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                if(spin > std::chrono::steady_clock::duration::zero())
+                {
+                    // The clock is read once every few checks, as it costs more than a check
+                    spin = std::min(spin, timeout);
+                    do
+                    {
+                        for(int i = 0; i < SPINS_PER_CLOCK_READ; ++i)
+                        {
+                            if(isSet())
+                            {
+                                return TRUE;
+                            }
+                            cpuRelax();
+                        }
+                    } while(std::chrono::steady_clock::now() - start < spin);
+                }
+
+                BOOL bInfinite = timeout == std::chrono::steady_clock::duration::max();
+                std::chrono::steady_clock::time_point deadline = bInfinite ? std::chrono::steady_clock::time_point::max() : start + timeout;
+                for(;;)
+                {
+                    // Announce the waiter, so that set() knows to wake it
+                    uint32_t state = STATE_UNSIGNALED;
+                    if(!m_state.compare_exchange_strong(state, STATE_WAITING, std::memory_order_acquire) && state == STATE_SIGNALED)
+                    {
+                        return TRUE;
+                    }
+
+                    std::chrono::steady_clock::duration remaining = std::chrono::steady_clock::duration::max();
+                    if(!bInfinite)
+                    {
+                        remaining = deadline - std::chrono::steady_clock::now();
+                        if(remaining <= std::chrono::steady_clock::duration::zero())
+                        {
+                            return isSet();
+                        }
+                    }
+                    park(remaining);
+
+                    if(isSet())
+                    {
+                        return TRUE;
+                    }
+                }
+            }
+
+            /*!
+            ** @brief Unsignals the event, so that it can be waited on again. Must not be called while any 
+            **        thread waits on the event.
+            */
+            void reset()
+            {
+                m_state.exchange(STATE_UNSIGNALED, std::memory_order_seq_cst);
+            }
+
+            /*!
+            ** @return Whether or not the event has been signaled. Never blocks, and never enters the kernel.
+            */
+            BOOL isSet() const
+            {
+                return m_state.load(std::memory_order_acquire) == STATE_SIGNALED;
+            }
+
+        private:
+            enum
+            {
+                STATE_UNSIGNALED,
+                STATE_SIGNALED,
+                STATE_WAITING
+            };
+
+            enum
+            {
+                SPINS_PER_CLOCK_READ = 64
+            };
+
+            // Blocks while the state is STATE_WAITING, for at most the remaining duration. May return spuriously.
+            void park(std::chrono::steady_clock::duration remaining) const
+            {
+#ifdef __linux__
+                timespec timeout;
+                timespec* pTimeout = NULL;
+                if(remaining != std::chrono::steady_clock::duration::max())
+                {
+                    std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining);
+                    timeout.tv_sec = static_cast<time_t>(ns.count() / 1000000000);
+                    timeout.tv_nsec = static_cast<long>(ns.count() % 1000000000);
+                    pTimeout = &timeout;
+                }
+                syscall(SYS_futex, getFutexWord(), FUTEX_WAIT_PRIVATE, STATE_WAITING, pTimeout, NULL, 0);
+#else
+                ParkingLot::Stripe& stripe = ParkingLot::getStripe(this);
+                std::unique_lock<std::mutex> lock(stripe.mutex);
+                if(m_state.load(std::memory_order_acquire) != STATE_WAITING)
+                {
+                    return;
+                }
+                if(remaining == std::chrono::steady_clock::duration::max())
+                {
+                    stripe.condition.wait(lock);
+                }
+                else
+                {
+                    stripe.condition.wait_for(lock, remaining);
+                }
+#endif
+            }
+
+            void wakeAll()
+            {
+#ifdef __linux__
+                syscall(SYS_futex, getFutexWord(), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+                // Taking the stripe lock orders the wakeup after any waiter's state check
+                ParkingLot::Stripe& stripe = ParkingLot::getStripe(this);
+                std::lock_guard<std::mutex> lock(stripe.mutex);
+                stripe.condition.notify_all();
+#endif
+            }
+
+#ifdef __linux__
+            uint32_t* getFutexWord() const
+            {
+                static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32 bit integer");
+                return reinterpret_cast<uint32_t*>(const_cast<std::atomic<uint32_t>*>(&m_state));
+            }
+#endif
+
+            mutable std::atomic<uint32_t> m_state;
+        };
+    }
+}
\ No newline at end of file
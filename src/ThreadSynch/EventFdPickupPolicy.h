@@ -0,0 +1,185 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include "PickupPolicyProvider.h"
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        /*!@class EventFd
+        ** @brief A non-blocking eventfd, which becomes readable once signaled, and stays so until acknowledged.
+        */
+        class EventFd : private boost::noncopyable
+        {
+        public:
+            EventFd()
+                : m_eventFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+            {
+                if(m_eventFd == -1)
+                {
+                    throw PickupSchedulingFailedException("eventfd creation failed");
+                }
+            }
+
+            ~EventFd()
+            {
+                close(m_eventFd);
+            }
+
+            void signal()
+            {
+                uint64_t increment = 1;
+                ssize_t result;
+                do
+                {
+                    result = write(m_eventFd, &increment, sizeof(increment));
+                } while(result == -1 && errno == EINTR);
+
+                // A full counter is still readable, so a write which would overflow it isn't a failure
+                if(result != sizeof(increment) && errno != EAGAIN)
+                {
+                    throw PickupSchedulingFailedException("eventfd write failed");
+                }
+            }
+
+            /*!
+            ** @return TRUE if the eventfd was signaled, in which case it no longer is.
+            */
+            BOOL acknowledge()
+            {
+                uint64_t counter;
+                ssize_t result;
+                do
+                {
+                    result = read(m_eventFd, &counter, sizeof(counter));
+                } while(result == -1 && errno == EINTR);
+                return result == sizeof(counter) ? TRUE : FALSE;
+            }
+
+            int get() const
+            {
+                return m_eventFd;
+            }
+
+        private:
+            int m_eventFd;
+        };
+    }
+
+    /*!@class EventFdPickupPolicy
+    ** @brief A pickup policy for Linux threads which run their own event loop, such as an epoll loop.
+    ** @remark
+    **   A target thread registers itself with registerCurrentThread, and adds the eventfd it gets back
+    **   to its epoll set. Whenever the fd becomes readable, the thread calls onReadable with its scheduler,
+    **   which runs the calls scheduled to the thread. There is no second wake-up mechanism, and no polling.
+    **
+    **   The scheduler only notifies a thread when its mailbox goes from empty to non-empty, so the fd is
+    **   written to once for a whole burst of calls, and the thread runs the burst in one go. The callback
+    **   the scheduler hands the policy is not needed: the thread's mailbox tells what is to be run.
+    **
+    **   Scheduling a call to a thread which isn't registered fails with PickupSchedulingFailedException.
+    */
+    class EventFdPickupPolicy : public PickupPolicyProvider
+    {
+    public:
+        static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+        {
+            boost::shared_ptr<details::EventFd> pEventFd = findEventFd(dwThreadId);
+            if(!pEventFd)
+            {
+                throw PickupSchedulingFailedException();
+            }
+            pEventFd->signal();
+        }
+
+        /*!
+        ** @brief Makes the calling thread a valid target for scheduled calls.
+        ** @return The eventfd to watch for readability. It stays open until the thread is unregistered.
+        ** @throw PickupSchedulingFailedException if the eventfd could not be created.
+        */
+        static int registerCurrentThread()
+        {
+            boost::shared_ptr<details::EventFd> pEventFd(new details::EventFd());
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry()[details::getCurrentThreadId()] = pEventFd;
+            return pEventFd->get();
+        }
+
+        /*!
+        ** @brief Removes the calling thread from the set of valid targets, and closes its eventfd once no
+        **        producer is writing to it. The thread should take the fd out of its epoll set first.
+        */
+        static void unregisterCurrentThread()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry().erase(details::getCurrentThreadId());
+        }
+
+        /*!
+        ** @brief Acknowledges the calling thread's eventfd, and runs the calls scheduled to the thread.
+        ** @param[in] pScheduler the scheduler the calls were made through, as in
+        **            onReadable(CallScheduler<EventFdPickupPolicy>::getInstance()).
+        ** @return TRUE if the eventfd had been signaled, FALSE on a spurious wake-up.
+        ** @remark The fd is acknowledged before the calls are collected, so calls scheduled while they run
+        **   signal it anew, rather than being missed.
+        */
+        template<class Scheduler>
+        static BOOL onReadable(Scheduler* pScheduler)
+        {
+            boost::shared_ptr<details::EventFd> pEventFd = findEventFd(details::getCurrentThreadId());
+            if(!pEventFd || !pEventFd->acknowledge())
+            {
+                return FALSE;
+            }
+            Scheduler::executeScheduledCalls(pScheduler);
+            return TRUE;
+        }
+
+    private:
+        typedef std::map<ThreadId, boost::shared_ptr<details::EventFd>> EVENTFDMAP;
+
+        static boost::shared_ptr<details::EventFd> findEventFd(ThreadId dwThreadId)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            EVENTFDMAP::iterator eventFdIter = registry().find(dwThreadId);
+            if(eventFdIter == registry().end())
+            {
+                return boost::shared_ptr<details::EventFd>();
+            }
+            return eventFdIter->second;
+        }
+
+        // The registry is intentionally never destroyed, as registered threads may well outlive
+        // static destruction.
+        static EVENTFDMAP& registry()
+        {
+            static EVENTFDMAP* pEventFds = new EVENTFDMAP();
+            return *pEventFds;
+        }
+
+        static std::mutex& registryMutex()
+        {
+            static std::mutex* pMutex = new std::mutex();
+            return *pMutex;
+        }
+    };
+}
\ No newline at end of file
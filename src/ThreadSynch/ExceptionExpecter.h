@@ -17,11 +17,20 @@
 #pragma once
 
 #include "ThrowHooked.h"
+#include "UniqueFunction.h"
+#include "CallSchedulerExceptions.h"
 
 namespace ThreadSynch
 {
+	class CallHandler;
+
 	namespace details
 	{
+		/*!
+		** @brief What a rethrown exception holds on to for as long as it lives: the call which caught it.
+		*/
+		typedef boost::intrusive_ptr<CallHandler> RethrowOwner;
+
 		enum CaughtExceptionType
 		{
 			CaughtExceptionType_None,
@@ -34,8 +43,8 @@ namespace ThreadSynch
 	** @brief A helper class which can call call a functor and catch a set of expected exceptions.
 	** @remark
 	**   If the class catches one of the expected exceptions, this exception can be rethrown,
-	**   possibly in context of another thread. The rethrower also accepts a functor, which will 
-	**   be called once the rethrown exception object is destroyed.
+	**   possibly in context of another thread. The rethrown exception object holds on to an owner,
+	**   the call which caught the exception, until it is destroyed.
 	*/		
 	template<typename E, int N = boost::mpl::size<E>::type::value>
 	class ExceptionExpecter;
@@ -61,19 +70,17 @@ namespace ThreadSynch
             boost::mpl::int_<n>                                                             \
         >::type /***************************************************************************/
 
-	// A generic catch block
-	// Todo: The catch block would be more efficient if we could 
-	// store a copy of the exception object instead of copying it
-	// throughout the functor copies. the same goes for the functor 
-	// itself. Both the functor and exception object can possibly be
-	// linked to the ExceptionExpecter class' lifetime.
+	// A generic catch block. The exception object is copied once, into
+	// the functor which rethrows it, and the functor is never copied.
 	#define CATCH(rep2_z, ExpectedId, rep2_data) /*****************************************/\
 		catch(EXCEPTION_TYPE(ExpectedId)& e)												\
 		{																					\
 			m_caughtExceptionType = details::CaughtExceptionType_Expected;					\
-			m_rethrowFunctor = boost::bind(throwEx ## ExpectedId, e, _1);					\
-			m_onCompleteFunctor(m_caughtExceptionType);										\
-			return;																			\
+			m_rethrowFunctor = [e](const details::RethrowOwner& pOwner)						\
+			{																				\
+				throwEx ## ExpectedId(e, pOwner);											\
+			};																				\
+			return m_caughtExceptionType;													\
 		} /*********************************************************************************/
 
 	// A catch block which deals with an exception object of one of the
@@ -81,14 +88,14 @@ namespace ThreadSynch
 	// be iterated and catched.
 	#define THROWEX(rep2_z, ExpectedId, rep2_data) /***************************************/\
 		static void rep2_data ## ExpectedId(const EXCEPTION_TYPE(ExpectedId)& exObj,		\
-											boost::function<void()>& onDestroyException)	\
+											const details::RethrowOwner& pOwner)			\
 		{																					\
-			details::throwHooked(exObj, onDestroyException);								\
+			details::throwHooked(exObj, pOwner);											\
 		} /*********************************************************************************/
 
 	// Generate the ExceptionExpecter class specializations for up to THREADSYNCH_MAX_EXPECTED_EXCEPTIONS
 	// predicted exception types
 	#define BOOST_PP_ITERATION_PARAMS_1 (3,(0,THREADSYNCH_MAX_EXPECTED_EXCEPTIONS,"ExceptionExpecter_template.h"))
-		??=include BOOST_PP_ITERATE()
+		#include BOOST_PP_ITERATE()
 	#undef BOOST_PP_ITERATION_PARAMS_1
 }
@@ -25,9 +25,8 @@ template<typename E>
 class ExceptionExpecter<E, BOOST_PP_ITERATION()>
 {
 public:
-	ExceptionExpecter(boost::function<void(details::CaughtExceptionType)> onCompleteFunctor)
-		: m_onCompleteFunctor(onCompleteFunctor),
-		  m_caughtExceptionType(details::CaughtExceptionType_None)
+	ExceptionExpecter()
+		: m_caughtExceptionType(details::CaughtExceptionType_None)
 	{}
 	
 	~ExceptionExpecter() {}
@@ -36,7 +35,8 @@ public:
 	// from the expected exceptions type vector
 	BOOST_PP_REPEAT_2ND(BOOST_PP_ITERATION(), THROWEX, throwEx)
 
-	void execute(boost::function<void()> functor)
+	template<class F>
+	details::CaughtExceptionType execute(F& functor)
 	{
 		try
 		{
@@ -49,38 +49,27 @@ public:
 		catch(...)
 		{
 			m_caughtExceptionType = details::CaughtExceptionType_Unknown;
-			m_rethrowFunctor = boost::bind(throwExUnexpected, _1);
-			m_onCompleteFunctor(m_caughtExceptionType);
-			return;
+			return m_caughtExceptionType;
 		}
 
-		// No exceptions caught, call the completion functor
-		m_onCompleteFunctor(m_caughtExceptionType);
+		// No exceptions caught
+		return m_caughtExceptionType;
 	}
 
-	void rethrow(boost::function<void()> onDestroyException)
+	void rethrow(const details::RethrowOwner& pOwner)
 	{
-		if(m_caughtExceptionType == details::CaughtExceptionType_Expected ||
-		   m_caughtExceptionType == details::CaughtExceptionType_Unknown)
+		if(m_caughtExceptionType == details::CaughtExceptionType_Expected)
 		{
-			m_rethrowFunctor(onDestroyException);
+			m_rethrowFunctor(pOwner);
+		}
+		else if(m_caughtExceptionType == details::CaughtExceptionType_Unknown)
+		{
+			details::throwHooked(UnexpectedException(), pOwner);
 		}
 	}
 
-	/*! 
-	** @brief releases any resources currently held by an ExceptionExpecter
-	**   instance, and deletes the instance itself.
-	*/
-	inline void free()
-	{ delete this; }
-
 private:
-	static void throwExUnexpected(boost::function<void()>& onExceptionDestroyed)
-	{
-		details::throwHooked(UnexpectedException(), onExceptionDestroyed);
-	}
-
-	boost::function<void(details::CaughtExceptionType)> m_onCompleteFunctor;
-	boost::function<void(boost::function<void()>&)> m_rethrowFunctor;
+	// Throws a copy of the expected exception caught, only set once one was
+	details::UniqueFunction<void (const details::RethrowOwner&)> m_rethrowFunctor;
 	details::CaughtExceptionType m_caughtExceptionType;
 };
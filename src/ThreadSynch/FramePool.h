@@ -0,0 +1,268 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        /*!@class FramePool
+        ** @brief A per-thread, size-classed pool of memory blocks for call frames.
+        ** @remark
+        **   Every thread which allocates gets a pool of its own, with one free list per size class of
+        **   THREADSYNCH_CACHE_LINE_SIZE bytes. A block remembers the pool it came from. Freeing a block
+        **   on the owning thread pushes it onto a free list; freeing it on any other thread pushes it
+        **   onto the owner's lock-free list of remote frees, which the owner reclaims the next time one
+        **   of its free lists runs dry. A thread which schedules calls therefore recycles the same
+        **   frames, no matter which thread releases them last.
+        **
+        **   Blocks larger than the biggest size class, and blocks beyond THREADSYNCH_FRAME_POOL_DEPTH
+        **   per free list, go straight to the global heap. A pool outlives its thread for as long as
+        **   any of its blocks are in use.
+        */
+        class FramePool : private boost::noncopyable
+        {
+        public:
+            /*!
+            ** @brief The alignment of every block handed out.
+            */
+            static const size_t ALIGNMENT = 16;
+
+            /*!
+            ** @brief Allocates a block of at least the specified size, from the calling thread's pool.
+            ** @throw std::bad_alloc if the global heap is exhausted.
+            */
+            static void* allocate(size_t size)
+            {
+                size_t sizeClass = (size + ALIGNMENT - 1) / THREADSYNCH_CACHE_LINE_SIZE;
+                FramePool* pPool = sizeClass < THREADSYNCH_FRAME_POOL_CLASSES ? getCurrentThreadPool() : NULL;
+                BlockHeader* pBlock = pPool != NULL ? pPool->take(sizeClass) : NULL;
+                if(pBlock == NULL)
+                {
+                    pBlock = static_cast<BlockHeader*>(::operator new(pPool != NULL ? (sizeClass + 1) * THREADSYNCH_CACHE_LINE_SIZE : size + ALIGNMENT));
+                    pBlock->pOwner = pPool;
+                    pBlock->sizeClass = sizeClass;
+                }
+
+                if(pPool != NULL)
+                {
+                    pPool->m_referenceCount.fetch_add(1, std::memory_order_relaxed);
+                }
+                return reinterpret_cast<char*>(pBlock) + ALIGNMENT;
+            }
+
+            /*!
+            ** @brief Returns a block to the pool it was allocated from. May be called from any thread.
+            */
+            static void deallocate(void* p)
+            {
+                if(p == NULL)
+                {
+                    return;
+                }
+
+                BlockHeader* pBlock = reinterpret_cast<BlockHeader*>(static_cast<char*>(p) - ALIGNMENT);
+                FramePool* pOwner = pBlock->pOwner;
+                if(pOwner == NULL)
+                {
+                    ::operator delete(pBlock);
+                    return;
+                }
+
+                if(pOwner == getCurrentThreadPoolSlot())
+                {
+                    pOwner->give(pBlock);
+                }
+                else
+                {
+                    pOwner->pushRemote(pBlock);
+                }
+                pOwner->release();
+            }
+
+        private:
+            // Occupies the first ALIGNMENT bytes of every block. While a block is on a free list, the
+            // owner is replaced by the link to the next free block, and the size class is kept.
+            struct BlockHeader
+            {
+                union
+                {
+                    FramePool* pOwner;
+                    BlockHeader* pNextFree;
+                };
+                size_t sizeClass;
+            };
+            static_assert(sizeof(BlockHeader) <= ALIGNMENT, "block header must fit in the alignment padding");
+
+            FramePool()
+                : m_referenceCount(1),
+                  m_pRemoteFree(NULL)
+            {
+                for(size_t i = 0; i < THREADSYNCH_FRAME_POOL_CLASSES; ++i)
+                {
+                    m_pFree[i] = NULL;
+                    m_freeCount[i] = 0;
+                }
+            }
+
+            ~FramePool()
+            {
+                for(size_t i = 0; i < THREADSYNCH_FRAME_POOL_CLASSES; ++i)
+                {
+                    freeList(m_pFree[i]);
+                }
+                freeList(m_pRemoteFree.exchange(NULL, std::memory_order_acquire));
+            }
+
+            // Owner thread only
+            BlockHeader* take(size_t sizeClass)
+            {
+                if(m_pFree[sizeClass] == NULL)
+                {
+                    reclaimRemote();
+                }
+
+                BlockHeader* pBlock = m_pFree[sizeClass];
+                if(pBlock != NULL)
+                {
+                    m_pFree[sizeClass] = pBlock->pNextFree;
+                    --m_freeCount[sizeClass];
+                    pBlock->pOwner = this;
+                    pBlock->sizeClass = sizeClass;
+                }
+                return pBlock;
+            }
+
+            // Owner thread only
+            void give(BlockHeader* pBlock)
+            {
+                size_t sizeClass = pBlock->sizeClass;
+                if(m_freeCount[sizeClass] >= THREADSYNCH_FRAME_POOL_DEPTH)
+                {
+                    ::operator delete(pBlock);
+                    return;
+                }
+                pBlock->pNextFree = m_pFree[sizeClass];
+                m_pFree[sizeClass] = pBlock;
+                ++m_freeCount[sizeClass];
+            }
+
+            // Any thread
+            void pushRemote(BlockHeader* pBlock)
+            {
+                BlockHeader* pHead = m_pRemoteFree.load(std::memory_order_relaxed);
+                do
+                {
+                    pBlock->pNextFree = pHead;
+                } while(!m_pRemoteFree.compare_exchange_weak(pHead, pBlock, std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            // Owner thread only
+            void reclaimRemote()
+            {
+                BlockHeader* pBlock = m_pRemoteFree.exchange(NULL, std::memory_order_acquire);
+                while(pBlock != NULL)
+                {
+                    BlockHeader* pNext = pBlock->pNextFree;
+                    give(pBlock);
+                    pBlock = pNext;
+                }
+            }
+
+            void release()
+            {
+                if(m_referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+
+            static void freeList(BlockHeader* pBlock)
+            {
+                while(pBlock != NULL)
+                {
+                    BlockHeader* pNext = pBlock->pNextFree;
+                    ::operator delete(pBlock);
+                    pBlock = pNext;
+                }
+            }
+
+            /*!
+            ** @brief Ties a pool to its thread. When the thread exits, the pool's free lists are
+            **        released, and the pool itself once its last block comes back.
+            */
+            struct ThreadPoolHolder
+            {
+                ThreadPoolHolder()
+                    : pPool(new FramePool())
+                {
+                    getCurrentThreadPoolSlot() = pPool;
+                }
+
+                ~ThreadPoolHolder()
+                {
+                    getCurrentThreadPoolSlot() = NULL;
+                    getTornDownFlag() = TRUE;
+                    for(size_t i = 0; i < THREADSYNCH_FRAME_POOL_CLASSES; ++i)
+                    {
+                        freeList(pPool->m_pFree[i]);
+                        pPool->m_pFree[i] = NULL;
+                        pPool->m_freeCount[i] = 0;
+                    }
+                    pPool->release();
+                }
+
+                FramePool* pPool;
+            };
+
+            // The slot and the flag are trivially destructible, so they can be read safely during thread teardown
+            static FramePool*& getCurrentThreadPoolSlot()
+            {
+                static thread_local FramePool* pPool = NULL;
+                return pPool;
+            }
+
+            static BOOL& getTornDownFlag()
+            {
+                static thread_local BOOL bTornDown = FALSE;
+                return bTornDown;
+            }
+
+            static FramePool* getCurrentThreadPool()
+            {
+                FramePool* pPool = getCurrentThreadPoolSlot();
+                if(pPool == NULL && !getTornDownFlag())
+                {
+                    // Allocations made after the holder is destroyed bypass the pool
+                    static thread_local ThreadPoolHolder holder;
+                    pPool = holder.pPool;
+                }
+                return pPool;
+            }
+
+            // Only touched by the owning thread
+            BlockHeader* m_pFree[THREADSYNCH_FRAME_POOL_CLASSES];
+            size_t m_freeCount[THREADSYNCH_FRAME_POOL_CLASSES];
+            char m_padding[THREADSYNCH_CACHE_LINE_SIZE];
+
+            // Written by other threads. The pool holds one reference for its thread, and one for every
+            // block which is in use.
+            std::atomic<long> m_referenceCount;
+            std::atomic<BlockHeader*> m_pRemoteFree;
+        };
+    }
+}
\ No newline at end of file
@@ -24,81 +24,136 @@ namespace ThreadSynch
 	** grab the return value after a successful call. CallHandler
 	** cannot be templated without major pain in the rest of the code,
 	** so this templated type does the work.
+	** @remark
+	**   Both the functor and the return value are stored inline, the functor 
+	**   as its own type, so a binder embedded in a call frame needs no 
+	**   allocations of its own, and calls the functor directly.
 	*/
-	template<typename T>
-	class FunctorRetvalBinder
+	template<typename T, class Functor>
+	class FunctorRetvalBinder : private boost::noncopyable
 	{
 	public:
 		/************************************************************************
 		** Functions
 		*/
 
-		FunctorRetvalBinder(boost::function<T()> functor, BYTE* pReturnValueBuffer)
-			: m_functor(functor),
-			  m_pReturnValueBuffer(pReturnValueBuffer)
-		{}
+		/*! 
+		** @brief Constructs the functor in place, from the specified constructor arguments.
+		*/
+		template<class... Arguments>
+		explicit FunctorRetvalBinder(Arguments&&... arguments)
+			: m_bFunctorSet(FALSE),
+			  m_bReturnValueSet(FALSE)
+		{
+			new (&m_functor) Functor(std::forward<Arguments>(arguments)...);
+			m_bFunctorSet = TRUE;
+		}
 
-		FunctorRetvalBinder(boost::function<void()> functor)
-			: m_functor(functor),
-			  m_pReturnValueBuffer(NULL)
-		{}
+		~FunctorRetvalBinder()
+		{
+			releaseFunctor();
 
-		~FunctorRetvalBinder();
+			// Destroy the bound return value
+			if(m_bReturnValueSet)
+			{
+				reinterpret_cast<T*>(&m_returnValue)->~T();
+			}
+		}
 
 		/*! 
 		** @brief executes the callback.
 		** @remark 
-		**   This function has one variation for T which are non-void,
-		**   in which case the return value is saved at the address passed to
-		**   the constructor. For T which is void, the return value is
-		**   obviously not stored -- or rather, there is no return value.
+		**   The return value is constructed in place in the inline buffer, from the
+		**   temporary returned by the functor. T need only be move constructible.
+		*/
+		inline void operator()()
+		{
+			new (&m_returnValue) T((*reinterpret_cast<Functor*>(&m_functor))());
+			m_bReturnValueSet = TRUE;
+		}
+
+		/*! 
+		** @return The address of the inline return value buffer.
 		*/
-		inline void execute();
+		inline void* getReturnValueBuffer()
+		{
+			return &m_returnValue;
+		}
 
 		/*! 
-		** @brief releases any resources currently held by an FunctorRetvalBinder
-		**   instance, and deletes the instance itself.
+		** @brief releases the functor, along with any bound parameters.
 		*/
-		inline void free()
-		{ delete this; }
+		inline void releaseFunctor()
+		{
+			if(m_bFunctorSet)
+			{
+				reinterpret_cast<Functor*>(&m_functor)->~Functor();
+				m_bFunctorSet = FALSE;
+			}
+		}
 
 	private:
 		/************************************************************************
 		** Variables
 		*/
 
-		boost::function<T(void)> m_functor;
-		BYTE* m_pReturnValueBuffer;
+		typename boost::aligned_storage<sizeof(Functor), boost::alignment_of<Functor>::value>::type m_functor;
+		typename boost::aligned_storage<sizeof(T), boost::alignment_of<T>::value>::type m_returnValue;
+
+		/*!
+		** Indicates whether or not the functor is alive. A cancelled call releases it early.
+		*/
+		BOOL m_bFunctorSet;
+
+		/*!
+		** Indicates whether or not a return value has been constructed in the buffer. A call which was
+		** withdrawn, or which threw, leaves nothing to destroy.
+		*/
+		BOOL m_bReturnValueSet;
 	};
 
 	/************************************************************************
-	** Implementation of non-inline and specialized template member functions
+	** Specialization for functors without a return value
 	*/
 
-	template<typename T>
-	FunctorRetvalBinder<T>::~FunctorRetvalBinder()
+	template<class Functor>
+	class FunctorRetvalBinder<void, Functor> : private boost::noncopyable
 	{
-		// Destroy the bound return value
-		reinterpret_cast<T*>(m_pReturnValueBuffer)->~T();
-	}
+	public:
+		template<class... Arguments>
+		explicit FunctorRetvalBinder(Arguments&&... arguments)
+			: m_bFunctorSet(FALSE)
+		{
+			new (&m_functor) Functor(std::forward<Arguments>(arguments)...);
+			m_bFunctorSet = TRUE;
+		}
 
-	template<>
-	FunctorRetvalBinder<void>::~FunctorRetvalBinder()
-	{
-	}
+		~FunctorRetvalBinder()
+		{
+			releaseFunctor();
+		}
 
-	template<typename T>
-	void FunctorRetvalBinder<T>::execute()
-	{
-		// Copy-construct the object into the allocated buffer, from the return 
-		// value of the functor. 
-		// The copy constructor of T is as such a requirement for the mechanism to work.
-		new (m_pReturnValueBuffer) T(m_functor());
-	}
-
-	template<>
-	void FunctorRetvalBinder<void>::execute()
-	{
-		m_functor();
-	}
+		inline void operator()()
+		{
+			(*reinterpret_cast<Functor*>(&m_functor))();
+		}
+
+		inline void* getReturnValueBuffer()
+		{
+			return NULL;
+		}
+
+		inline void releaseFunctor()
+		{
+			if(m_bFunctorSet)
+			{
+				reinterpret_cast<Functor*>(&m_functor)->~Functor();
+				m_bFunctorSet = FALSE;
+			}
+		}
+
+	private:
+		typename boost::aligned_storage<sizeof(Functor), boost::alignment_of<Functor>::value>::type m_functor;
+		BOOL m_bFunctorSet;
+	};
 }
\ No newline at end of file
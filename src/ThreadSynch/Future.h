@@ -31,19 +31,23 @@ namespace ThreadSynch
         **          guard, so be vary.
         ** @param[in] abortCallback a callback to a function which aborts the computation of the future variable.
         ** @param[in] waitCallback a callback which waits a number of milliseconds for the computation to take place.
-        ** @param[in] getReturnValueCallback a callback which returns the computed future variable.
+        ** @param[in] getReturnValueCallback a callback which returns the address of the computed future variable.
         ** @throw std::bad_alloc The inner Future_Impl could not be allocated.
         */
         Future(typename Future_Impl<T>::ABORTCALLBACKTYPE abortCallback,
                typename Future_Impl<T>::WAITCALLBACKTYPE waitCallback,
                typename Future_Impl<T>::GETRETURNVALUECALLBACKTYPE getReturnValueCallback)
-               : m_pFutureImpl(new Future_Impl<T>(abortCallback, waitCallback, getReturnValueCallback))
+               : m_pFutureImpl(boost::make_shared<Future_Impl<T>>(std::move(abortCallback), std::move(waitCallback), std::move(getReturnValueCallback)))
         {}
 
         Future(const Future& other)
             : m_pFutureImpl(other.m_pFutureImpl)
         {}
 
+        Future(Future&& other)
+            : m_pFutureImpl(std::move(other.m_pFutureImpl))
+        {}
+
         /*! 
         ** @brief Waits for the future computation to take place.
         ** @param[in] dwTimeout number of milliseconds to wait before terminating.
@@ -69,15 +73,29 @@ namespace ThreadSynch
         /*! 
         ** @brief Waits for the future computation to take place.
         ** @param[in] dwTimeout number of milliseconds to wait before terminating.
-        ** @return the value. 
+        ** @return a copy of the value. 
         ** @throw FutureValuePending The value is still being computed, the computation has been aborted, or an internal 
         **        error has occured.
+        ** @throw FutureValueTaken The value has been moved out by take.
         */
         T getValue() const // May throw
         {
             return m_pFutureImpl->getValue();
         }
 
+        /*! 
+        ** @brief Moves the computed value out of the Future. This is the only way to get at a value of a move-only
+        **        type, and saves a copy for any other type.
+        ** @return the value.
+        ** @throw FutureValuePending The value is still being computed, the computation has been aborted, or an internal 
+        **        error has occured.
+        ** @throw FutureValueTaken The value has already been taken, through this Future or a copy of it.
+        */
+        T take() // May throw
+        {
+            return m_pFutureImpl->take();
+        }
+
     private:
         boost::shared_ptr<Future_Impl<T>> m_pFutureImpl;
         Future& operator=(const Future& other); // Not implemented
@@ -99,13 +117,17 @@ namespace ThreadSynch
         */
         Future(Future_Impl<void>::ABORTCALLBACKTYPE abortCallback,
                Future_Impl<void>::WAITCALLBACKTYPE waitCallback)
-               : m_pFutureImpl(new Future_Impl<void>(abortCallback, waitCallback))
+               : m_pFutureImpl(boost::make_shared<Future_Impl<void>>(std::move(abortCallback), std::move(waitCallback)))
         {}
 
         Future(const Future& other)
             : m_pFutureImpl(other.m_pFutureImpl)
         {}
 
+        Future(Future&& other)
+            : m_pFutureImpl(std::move(other.m_pFutureImpl))
+        {}
+
         /*! 
         ** @brief Waits for the future computation to take place.
         ** @param[in] dwTimeout number of milliseconds to wait before terminating.
@@ -31,10 +31,38 @@ namespace ThreadSynch
     {
     public:
         FutureValuePending()
+            : m_what("FutureValuePending")
         {}
 
         FutureValuePending(const char *const& _What)
-            : std::exception(_What)
+            : m_what(_What)
         {}
+
+        virtual const char* what() const throw()
+        { return m_what; }
+
+    private:
+        const char* m_what;
+    };
+
+    /*!@class FutureValueTaken
+    ** @brief thrown when the value of a Future object is requested after it has been moved out by Future::take.
+    */
+    class FutureValueTaken : public std::exception
+    {
+    public:
+        FutureValueTaken()
+            : m_what("FutureValueTaken")
+        {}
+
+        FutureValueTaken(const char *const& _What)
+            : m_what(_What)
+        {}
+
+        virtual const char* what() const throw()
+        { return m_what; }
+
+    private:
+        const char* m_what;
     };
 }
\ No newline at end of file
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "FutureExceptions.h"
+#include "UniqueFunction.h"
 
 namespace ThreadSynch
 {
@@ -43,7 +44,19 @@ namespace ThreadSynch
         /*!
         ** @brief Indicates that the computation has been aborted (successfully)
         */
-        ASYNCH_CALL_ABORTED
+        ASYNCH_CALL_ABORTED,
+
+        /*!
+        ** @brief Indicates that the computation was replaced by a later call with the same coalescing key,
+        **        before it could start
+        */
+        ASYNCH_CALL_SUPERSEDED,
+
+        /*!
+        ** @brief Indicates that the computation was dropped from the target thread's full queue, to make
+        **        room for a newer call, before it could start
+        */
+        ASYNCH_CALL_DROPPED
     };
 
     /************************************************************************
@@ -54,16 +67,17 @@ namespace ThreadSynch
     class Future_Impl : private boost::noncopyable
     {
     public:
-        typedef boost::function<ASYNCH_CALL_STATUS()> ABORTCALLBACKTYPE;
-        typedef boost::function<ASYNCH_CALL_STATUS(DWORD)> WAITCALLBACKTYPE;
-        typedef boost::function<T()> GETRETURNVALUECALLBACKTYPE;
+        typedef details::UniqueFunction<ASYNCH_CALL_STATUS()> ABORTCALLBACKTYPE;
+        typedef details::UniqueFunction<ASYNCH_CALL_STATUS(DWORD)> WAITCALLBACKTYPE;
+        typedef details::UniqueFunction<T*()> GETRETURNVALUECALLBACKTYPE;
 
         Future_Impl(ABORTCALLBACKTYPE abortCallback,
                     WAITCALLBACKTYPE waitCallback,
                     GETRETURNVALUECALLBACKTYPE getReturnValueCallback)
-            : m_abortCallback(abortCallback),
-              m_waitCallback(waitCallback),
-              m_getReturnValueCallback(getReturnValueCallback)
+            : m_abortCallback(std::move(abortCallback)),
+              m_waitCallback(std::move(waitCallback)),
+              m_getReturnValueCallback(std::move(getReturnValueCallback)),
+              m_bValueTaken(FALSE)
         {
         }
 
@@ -93,13 +107,35 @@ namespace ThreadSynch
             {
                 throw FutureValuePending();
             }
-            return m_getReturnValueCallback();
+            if(m_bValueTaken.load(std::memory_order_acquire))
+            {
+                throw FutureValueTaken();
+            }
+            return *m_getReturnValueCallback();
+        }
+
+        T take()
+        {
+            if(wait(0) != ASYNCH_CALL_COMPLETE)
+            {
+                throw FutureValuePending();
+            }
+            if(m_bValueTaken.exchange(TRUE, std::memory_order_acq_rel))
+            {
+                throw FutureValueTaken();
+            }
+            return std::move(*m_getReturnValueCallback());
         }
 
     private:
         ABORTCALLBACKTYPE m_abortCallback;
         WAITCALLBACKTYPE m_waitCallback;
         GETRETURNVALUECALLBACKTYPE m_getReturnValueCallback;
+
+        /*!
+        ** Set once the value has been moved out by take. Copies of a Future share it, so only one of them gets the value.
+        */
+        std::atomic<BOOL> m_bValueTaken;
     };
 
     /************************************************************************
@@ -110,13 +146,13 @@ namespace ThreadSynch
     class Future_Impl<void> : private boost::noncopyable
     {
     public:
-        typedef boost::function<ASYNCH_CALL_STATUS()> ABORTCALLBACKTYPE;
-        typedef boost::function<ASYNCH_CALL_STATUS(DWORD)> WAITCALLBACKTYPE;
+        typedef details::UniqueFunction<ASYNCH_CALL_STATUS()> ABORTCALLBACKTYPE;
+        typedef details::UniqueFunction<ASYNCH_CALL_STATUS(DWORD)> WAITCALLBACKTYPE;
 
         Future_Impl(ABORTCALLBACKTYPE abortCallback,
                     WAITCALLBACKTYPE waitCallback)
-            : m_abortCallback(abortCallback),
-              m_waitCallback(waitCallback)
+            : m_abortCallback(std::move(abortCallback)),
+              m_waitCallback(std::move(waitCallback))
         {
         }
 
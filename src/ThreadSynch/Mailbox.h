@@ -0,0 +1,981 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include "CallHandler.h"
+#include "AdaptiveSpin.h"
+
+namespace ThreadSynch
+{
+    /*!
+    ** @brief What a producer does when it finds a bounded mailbox full.
+    ** @sa CallScheduler::setQueueCapacity
+    */
+    enum QUEUE_FULL_POLICY
+    {
+        /*!
+        ** @brief Wait for the target thread to make room, up to a timeout, and then throw CallQueueFullException
+        */
+        QUEUE_FULL_BLOCK,
+
+        /*!
+        ** @brief Throw CallQueueFullException right away
+        */
+        QUEUE_FULL_FAIL,
+
+        /*!
+        ** @brief Drop the oldest queued asynchronous call, whose Future then reports ASYNCH_CALL_DROPPED
+        */
+        QUEUE_FULL_DROP_OLDEST
+    };
+
+    namespace details
+    {
+        /*!@class Mailbox
+        ** @brief A multi-producer, single-consumer queue of CallHandlers, owned by one target thread.
+        ** @remark
+        **   The mailbox has one lane per CALL_PRIORITY. Producers push onto a lane's lock-free stack with a
+        **   single compare-and-swap, and only the push which finds the owner un-notified schedules a pickup.
+        **   The owning thread detaches each stack with one atomic exchange, and reverses it into a private
+        **   list, ordered by scheduling or, optionally, by deadline. Handlers are linked through their own
+        **   m_pNextQueued member, so queueing a call never allocates. The producer side and the consumer
+        **   side are kept on separate cache lines.
+        **
+        **   Collected calls are handed out from the highest priority lane which has any. A lower lane which
+        **   has been passed over THREADSYNCH_PRIORITY_AGING times in a row gets the next turn, so a steady
+        **   stream of interactive calls can delay bulk calls, but never starve them. How many calls, or how
+        **   much time, a single pickup may spend is limited by the thread's pickup budget.
+        **
+        **   Calls scheduled with CallScheduler::asyncCallCoalesced take one place in the queue per key, kept
+        **   in the coalescing map. Later calls with the key are attached to that place rather than pushed,
+        **   and only the latest of them runs, once the owner gets to the place.
+        **
+        **   The mailbox counts the calls queued in it. Producers reserve room before they push, and the owner
+        **   gives it back as it pops, which is what bounds the mailbox and drives its watermark callback.
+        **
+        **   While its owner waits, the mailbox holds the wait's state. In a pumping wait, producers set its
+        **   pump event, so that calls scheduled to the waiting thread run right away. In a blocking syncCall,
+        **   it points at the mailbox of the thread called, and these pointers form the wait-for graph which
+        **   deadlocks are detected in. It also times the synchronous calls made to its thread, to tune how
+        **   long their callers spin.
+        */
+        class Mailbox : private boost::noncopyable
+        {
+        public:
+            explicit Mailbox(ThreadId ownerThreadId)
+                : m_ownerThreadId(ownerThreadId),
+                  m_bNotified(FALSE),
+                  m_bPickupRearmed(FALSE),
+                  m_maxCallsPerPickup(0),
+                  m_dwMaxMicrosecondsPerPickup(0),
+                  m_bDeadlineOrdering(FALSE),
+                  m_queuedCount(0),
+                  m_waitingProducers(0),
+                  m_capacity(0),
+                  m_fullPolicy(QUEUE_FULL_BLOCK),
+                  m_dwFullTimeout(INFINITE),
+                  m_highWatermark(0),
+                  m_lowWatermark(0),
+                  m_bAboveHighWatermark(FALSE),
+                  m_bPumpingWaits(FALSE),
+                  m_pumpingDepth(0),
+                  m_pWaitingFor(NULL)
+            {
+                for(size_t i = 0; i < CALL_PRIORITY_COUNT; ++i)
+                {
+                    m_pushedLanes[i].pPushed.store(NULL, std::memory_order_relaxed);
+                    m_pendingLanes[i].pPending = NULL;
+                    m_pendingLanes[i].pPendingTail = NULL;
+                    m_pendingLanes[i].passedOverCount = 0;
+                }
+            }
+
+            /*!
+            ** @brief Releases the references held on handlers which were never picked up.
+            */
+            ~Mailbox()
+            {
+                CallHandler* pCallHandler;
+                while((pCallHandler = pop()) != NULL)
+                {
+                    intrusive_ptr_release(pCallHandler);
+                }
+                for(COALESCEDCALLS::iterator it = m_coalescedCalls.begin(); it != m_coalescedCalls.end(); ++it)
+                {
+                    if(it->second.pLatest != it->second.pQueued)
+                    {
+                        intrusive_ptr_release(it->second.pLatest);
+                    }
+                }
+                releaseDroppable(m_droppable.size());
+            }
+
+            /*!
+            ** @brief Adds a handler to the mailbox. May be called from any thread.
+            ** @param[in] pCallHandler the handler to queue. The mailbox takes over one reference,
+            **   which the consumer releases once the handler has been popped and dealt with.
+            ** @param[in] priority the lane to queue the handler in.
+            ** @return TRUE if the owner must be notified, which is once per collection.
+            */
+            BOOL push(CallHandler* pCallHandler, CALL_PRIORITY priority)
+            {
+                return pushAll(&pCallHandler, &pCallHandler + 1, priority);
+            }
+
+            /*!
+            ** @brief Adds a sequence of handlers to the mailbox with a single compare-and-swap, so that they are
+            **        picked up in order, and with no other calls of the same priority in between. May be called
+            **        from any thread.
+            ** @param[in] first, last a non-empty range of handlers, or of smart pointers to handlers. The mailbox
+            **   takes over one reference on each.
+            ** @param[in] priority the lane to queue the handlers in.
+            ** @return TRUE if the owner must be notified, which is once per collection.
+            */
+            template<class Iterator>
+            BOOL pushAll(Iterator first, Iterator last, CALL_PRIORITY priority)
+            {
+                // Link the handlers newest first, which is the order the stack keeps them in
+                CallHandler* pOldest = &**first;
+                CallHandler* pNewest = pOldest;
+                for(++first; first != last; ++first)
+                {
+                    CallHandler* pCallHandler = &**first;
+                    pCallHandler->m_pNextQueued = pNewest;
+                    pNewest = pCallHandler;
+                }
+
+                std::atomic<CallHandler*>& pushed = m_pushedLanes[priority].pPushed;
+                CallHandler* pHead = pushed.load(std::memory_order_relaxed);
+                do
+                {
+                    pOldest->m_pNextQueued = pHead;
+                } while(!pushed.compare_exchange_weak(pHead, pNewest, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+                // The owner clears the flag before it collects, so whichever push comes after a collection
+                // notifies it again. The flag is read first, so that pushes into a notified mailbox don't
+                // contend on it.
+                return !m_bNotified.load(std::memory_order_seq_cst) && !m_bNotified.exchange(TRUE, std::memory_order_seq_cst);
+            }
+
+            /*!
+            ** @brief Clears the notification, after notifying the owner has failed, so that the next push
+            **        notifies it again. May be called from any thread.
+            ** @remark
+            **   Whatever is pushed stays queued, for the next notification which succeeds to deliver. That
+            **   includes calls other producers pushed while the owner was thought to be notified.
+            */
+            void clearNotified()
+            {
+                m_bNotified.store(FALSE, std::memory_order_seq_cst);
+            }
+
+            /*!
+            ** @brief Returns the mailbox to the state it was created in, cancelling the calls queued in it, so
+            **        that a thread which gets the id of an exited owner doesn't inherit its calls, notification
+            **        or settings. May only be called by the owning thread, outside of any pickup.
+            */
+            void reset()
+            {
+                collect();
+                for(size_t i = 0; i < CALL_PRIORITY_COUNT; ++i)
+                {
+                    PendingLane& lane = m_pendingLanes[i];
+                    while(lane.pPending != NULL)
+                    {
+                        CallHandler* pCallHandler = lane.pPending;
+                        lane.pPending = pCallHandler->m_pNextQueued;
+                        pCallHandler->m_pNextQueued = NULL;
+                        discard(pCallHandler);
+                    }
+                    lane.pPendingTail = NULL;
+                    lane.passedOverCount = 0;
+                }
+                m_bPickupRearmed = FALSE;
+
+                setPickupBudget(0, 0);
+                setDeadlineOrdering(FALSE);
+                setCapacity(0, QUEUE_FULL_BLOCK, INFINITE);
+                setWatermarks(0, 0, boost::function<void (BOOL)>());
+                setPumpingWaits(FALSE);
+                m_pWaitingFor.store(NULL, std::memory_order_seq_cst);
+                m_pumpEvent.reset();
+            }
+
+            /*!
+            ** @brief Takes the next handler off the mailbox. May only be called by the owning thread.
+            ** @return The handler, along with the reference the mailbox held, or NULL if the mailbox is empty.
+            */
+            CallHandler* pop()
+            {
+                collect();
+                return popCollected();
+            }
+
+            /*!
+            ** @brief Detaches everything pushed so far, and queues it behind what earlier collections left.
+            **        May only be called by the owning thread.
+            ** @remark 
+            **   A pickup collects once, and then only pops what it collected, so calls scheduled while it
+            **   runs wait for the next pickup rather than prolonging this one.
+            */
+            void collect()
+            {
+                m_bNotified.store(FALSE, std::memory_order_seq_cst);
+                for(size_t i = 0; i < CALL_PRIORITY_COUNT; ++i)
+                {
+                    collectLane(i);
+                }
+            }
+
+            /*!
+            ** @brief Takes the next collected handler off the mailbox, by priority and age. May only be called
+            **        by the owning thread.
+            ** @return The handler, along with the reference the mailbox held, or NULL if nothing collected is left.
+            */
+            CallHandler* popCollected()
+            {
+                // Serve the highest lane with calls, unless a lower one has waited its turn too long
+                size_t servedLane = CALL_PRIORITY_COUNT;
+                for(size_t i = 0; i < CALL_PRIORITY_COUNT; ++i)
+                {
+                    if(m_pendingLanes[i].pPending == NULL)
+                    {
+                        continue;
+                    }
+                    if(servedLane == CALL_PRIORITY_COUNT)
+                    {
+                        servedLane = i;
+                    }
+                    else if(m_pendingLanes[i].passedOverCount >= THREADSYNCH_PRIORITY_AGING)
+                    {
+                        servedLane = i;
+                        break;
+                    }
+                }
+                if(servedLane == CALL_PRIORITY_COUNT)
+                {
+                    return NULL;
+                }
+
+                for(size_t i = 0; i < CALL_PRIORITY_COUNT; ++i)
+                {
+                    if(i == servedLane)
+                    {
+                        m_pendingLanes[i].passedOverCount = 0;
+                    }
+                    else if(m_pendingLanes[i].pPending != NULL)
+                    {
+                        ++m_pendingLanes[i].passedOverCount;
+                    }
+                }
+
+                PendingLane& lane = m_pendingLanes[servedLane];
+                CallHandler* pCallHandler = lane.pPending;
+                lane.pPending = pCallHandler->m_pNextQueued;
+                pCallHandler->m_pNextQueued = NULL;
+                return pCallHandler;
+            }
+
+            /*!
+            ** @return The id of the thread, or other pickup target, the mailbox belongs to.
+            */
+            ThreadId getOwnerThreadId() const
+            {
+                return m_ownerThreadId;
+            }
+
+            /*!
+            ** @brief Checks whether any handlers have been pushed since the last collect. Only reads the lane
+            **        heads, so polling an empty mailbox doesn't contend with producers. Never blocks.
+            */
+            BOOL hasPushed() const
+            {
+                for(size_t i = 0; i < CALL_PRIORITY_COUNT; ++i)
+                {
+                    if(m_pushedLanes[i].pPushed.load(std::memory_order_relaxed) != NULL)
+                    {
+                        return TRUE;
+                    }
+                }
+                return FALSE;
+            }
+
+            /*!
+            ** @brief Checks whether any collected handlers are left to pop. May only be called by the owning thread.
+            */
+            BOOL hasCollected() const
+            {
+                for(size_t i = 0; i < CALL_PRIORITY_COUNT; ++i)
+                {
+                    if(m_pendingLanes[i].pPending != NULL)
+                    {
+                        return TRUE;
+                    }
+                }
+                return FALSE;
+            }
+
+            /*!
+            ** @brief Tracks whether a pickup has been scheduled for the collected handlers left over by an
+            **        earlier pickup. May only be called by the owning thread.
+            */
+            BOOL isPickupRearmed() const
+            {
+                return m_bPickupRearmed;
+            }
+
+            void setPickupRearmed(BOOL bRearmed)
+            {
+                m_bPickupRearmed = bRearmed;
+            }
+
+            /*!
+            ** @brief Limits the work done by each pickup. May be called from any thread.
+            ** @param[in] maxCalls the number of calls a pickup may run, or 0 for no limit.
+            ** @param[in] dwMaxMicroseconds the time a pickup may spend running calls, or 0 for no limit.
+            */
+            void setPickupBudget(size_t maxCalls, DWORD dwMaxMicroseconds)
+            {
+                m_maxCallsPerPickup.store(maxCalls, std::memory_order_relaxed);
+                m_dwMaxMicrosecondsPerPickup.store(dwMaxMicroseconds, std::memory_order_relaxed);
+            }
+
+            size_t getMaxCallsPerPickup() const
+            {
+                return m_maxCallsPerPickup.load(std::memory_order_relaxed);
+            }
+
+            DWORD getMaxMicrosecondsPerPickup() const
+            {
+                return m_dwMaxMicrosecondsPerPickup.load(std::memory_order_relaxed);
+            }
+
+            /*!
+            ** @brief Selects earliest deadline first ordering within each lane. May be called from any thread.
+            ** @remark Calls without a deadline go after those with one, in scheduling order.
+            */
+            void setDeadlineOrdering(BOOL bDeadlineOrdering)
+            {
+                m_bDeadlineOrdering.store(bDeadlineOrdering, std::memory_order_relaxed);
+            }
+
+            /*!
+            ** @brief Attaches a coalesced handler to the queued handler with the same key, superseding any
+            **        handler attached before it. May be called from any thread.
+            ** @param[in] pCallHandler the handler, marked with its coalescing key.
+            ** @retval TRUE the handler was attached, and the mailbox holds a reference to it. It must not be pushed.
+            ** @retval FALSE no handler with the key was queued. This one now holds the key's place, and must be 
+            **   pushed.
+            */
+            BOOL attachCoalesced(CallHandler* pCallHandler)
+            {
+                std::lock_guard<std::mutex> lock(m_coalescingMutex);
+                COALESCEDCALLS::iterator it = m_coalescedCalls.find(pCallHandler->getCoalescingKey());
+                if(it == m_coalescedCalls.end())
+                {
+                    CoalescedCall coalescedCall = { pCallHandler, pCallHandler };
+                    m_coalescedCalls.insert(std::make_pair(pCallHandler->getCoalescingKey(), coalescedCall));
+                    return FALSE;
+                }
+
+                // Calls attached earlier never made it into the queue, so they can be let go of right away
+                if(it->second.pLatest != it->second.pQueued)
+                {
+                    it->second.pLatest->supersede();
+                    intrusive_ptr_release(it->second.pLatest);
+                }
+                intrusive_ptr_add_ref(pCallHandler);
+                it->second.pLatest = pCallHandler;
+                return TRUE;
+            }
+
+            /*!
+            ** @brief Ends the coalescing of a popped, or discarded, handler's key. May be called from any thread.
+            ** @param[in] pQueued a coalesced handler, just popped.
+            ** @return The latest handler attached to it, along with the reference the mailbox held, or NULL if
+            **   none was.
+            */
+            CallHandler* detachCoalesced(CallHandler* pQueued)
+            {
+                std::lock_guard<std::mutex> lock(m_coalescingMutex);
+                COALESCEDCALLS::iterator it = m_coalescedCalls.find(pQueued->getCoalescingKey());
+                if(it == m_coalescedCalls.end() || it->second.pQueued != pQueued)
+                {
+                    // The handler's place was abandoned, and the key may since have gone to another handler
+                    return NULL;
+                }
+                CallHandler* pLatest = it->second.pLatest;
+                m_coalescedCalls.erase(it);
+                return pLatest != pQueued ? pLatest : NULL;
+            }
+
+            /*!
+            ** @brief Gives up the place held by a coalesced handler which could not be queued, so that the
+            **        next handler with the key takes a place of its own. Handlers attached to it in the
+            **        meantime are cancelled. May be called from any thread.
+            */
+            void abandonCoalesced(CallHandler* pQueued)
+            {
+                CallHandler* pLatest = detachCoalesced(pQueued);
+                if(pLatest != NULL)
+                {
+                    pLatest->cancel();
+                    intrusive_ptr_release(pLatest);
+                }
+            }
+
+            /*!
+            ** @brief Limits the number of calls queued in the mailbox. May be called from any thread.
+            ** @param[in] capacity the number of calls which may be queued, or 0 for no limit.
+            ** @param[in] policy what a producer which finds the mailbox full does.
+            ** @param[in] dwTimeout how long a producer waits for room under QUEUE_FULL_BLOCK.
+            ** @remark Producers waiting for room are woken, so that they see the new capacity.
+            */
+            void setCapacity(size_t capacity, QUEUE_FULL_POLICY policy, DWORD dwTimeout)
+            {
+                std::lock_guard<std::mutex> lock(m_spaceMutex);
+                m_capacity.store(capacity, std::memory_order_relaxed);
+                m_fullPolicy.store(policy, std::memory_order_relaxed);
+                m_dwFullTimeout.store(dwTimeout, std::memory_order_relaxed);
+                if(capacity == 0 || policy != QUEUE_FULL_DROP_OLDEST)
+                {
+                    releaseDroppable(m_droppable.size());
+                }
+                m_spaceAvailable.notify_all();
+            }
+
+            /*!
+            ** @brief Sets the queue depths at which the watermark callback is called. May be called from any thread.
+            ** @param[in] highWatermark the depth at which the callback is called with TRUE, or 0 for none.
+            ** @param[in] lowWatermark the depth at which the callback is then called with FALSE.
+            ** @param[in] callback the callback. It is called by the producer which reaches the high watermark,
+            **   and by the owning thread when it drains the mailbox down to the low one. 
+            */
+            void setWatermarks(size_t highWatermark, size_t lowWatermark, const boost::function<void (BOOL)>& callback)
+            {
+                std::lock_guard<std::mutex> lock(m_spaceMutex);
+                m_watermarkCallback = callback;
+                m_lowWatermark.store(lowWatermark, std::memory_order_relaxed);
+                m_highWatermark.store(highWatermark, std::memory_order_relaxed);
+                m_bAboveHighWatermark.store(FALSE, std::memory_order_relaxed);
+            }
+
+            /*!
+            ** @brief Selects whether or not the owning thread runs its calls while it waits for calls it 
+            **        has made. May be called from any thread.
+            */
+            void setPumpingWaits(BOOL bPumpingWaits)
+            {
+                m_bPumpingWaits.store(bPumpingWaits, std::memory_order_relaxed);
+            }
+
+            /*!
+            ** @return Whether or not the owning thread should start a pumping wait now, which it may not if 
+            **   the wait would nest too deep. May only be called by the owning thread.
+            */
+            BOOL canPump() const
+            {
+                return m_bPumpingWaits.load(std::memory_order_relaxed) && 
+                       m_pumpingDepth.load(std::memory_order_relaxed) < THREADSYNCH_MAX_PUMPING_DEPTH;
+            }
+
+            /*!
+            ** @brief Enters and leaves a pumping wait. May only be called by the owning thread.
+            */
+            void enterPumping()
+            {
+                m_pumpingDepth.fetch_add(1, std::memory_order_seq_cst);
+            }
+
+            void leavePumping()
+            {
+                m_pumpingDepth.fetch_sub(1, std::memory_order_seq_cst);
+            }
+
+            /*!
+            ** @brief Wakes the owner, if it's in a pumping wait or parked in CallScheduler::pump. Called by 
+            **        producers after every push.
+            */
+            void wakePumpingOwner()
+            {
+                if(m_pumpingDepth.load(std::memory_order_seq_cst) != 0)
+                {
+                    m_pumpEvent.set();
+                }
+            }
+
+            /*!
+            ** @brief Records the mailbox of the thread the owner is about to block on, or NULL once it no 
+            **        longer does. May only be called by the owning thread.
+            ** @return The mailbox recorded before, to be restored once the wait ends.
+            */
+            Mailbox* setWaitingFor(Mailbox* pTarget)
+            {
+                return m_pWaitingFor.exchange(pTarget, std::memory_order_seq_cst);
+            }
+
+            /*!
+            ** @return Whether or not the threads the owner waits for, directly or through other threads,
+            **   include the owner itself. Two threads which start waiting for each other at the same time
+            **   both record their wait before they look, so at least one of them sees the cycle.
+            */
+            BOOL isWaitCycle() const
+            {
+                // Each thread waits for at most one other, so the walk can't branch. A cycle the owner
+                // isn't part of would go round forever, hence the limit.
+                const Mailbox* pMailbox = m_pWaitingFor.load(std::memory_order_seq_cst);
+                for(size_t steps = 0; pMailbox != NULL && steps < MAX_WAIT_CHAIN; ++steps)
+                {
+                    if(pMailbox == this)
+                    {
+                        return TRUE;
+                    }
+                    pMailbox = pMailbox->m_pWaitingFor.load(std::memory_order_seq_cst);
+                }
+                return FALSE;
+            }
+
+            /*!
+            ** @return The event a pumping wait, or a pump, parks on.
+            */
+            CompletionEvent& getPumpEvent()
+            {
+                return m_pumpEvent;
+            }
+
+            /*!
+            ** @return The spin tuning of synchronous calls to the owning thread.
+            */
+            AdaptiveSpin& getSyncSpin()
+            {
+                return m_syncSpin;
+            }
+
+            /*!
+            ** @return The number of calls queued, and not yet popped by the owning thread.
+            */
+            size_t getQueuedCount() const
+            {
+                return m_queuedCount.load(std::memory_order_relaxed);
+            }
+
+            /*!
+            ** @brief Reserves room for calls about to be pushed. May be called from any thread.
+            ** @param[in] count the number of calls.
+            ** @retval TRUE the room was reserved, dropping older calls under QUEUE_FULL_DROP_OLDEST if need be.
+            ** @retval FALSE the mailbox is full. Under QUEUE_FULL_BLOCK the producer may wait with waitReserve.
+            */
+            BOOL reserve(size_t count)
+            {
+                size_t queued;
+                size_t capacity = m_capacity.load(std::memory_order_relaxed);
+                if(capacity == 0)
+                {
+                    queued = m_queuedCount.fetch_add(count, std::memory_order_seq_cst) + count;
+                }
+                else if(!tryReserve(count, capacity, queued) && 
+                        (m_fullPolicy.load(std::memory_order_relaxed) != QUEUE_FULL_DROP_OLDEST || !dropFor(count, capacity, queued)))
+                {
+                    return FALSE;
+                }
+                checkHighWatermark(queued);
+                return TRUE;
+            }
+
+            /*!
+            ** @brief Waits for room for calls about to be pushed, under QUEUE_FULL_BLOCK. Must not be called 
+            **        by the owning thread, which is the only one to make room.
+            ** @param[in] count the number of calls.
+            ** @retval TRUE the room was reserved.
+            ** @retval FALSE the mailbox stayed full for the policy's timeout, or its policy doesn't block.
+            */
+            BOOL waitReserve(size_t count)
+            {
+                size_t capacity = m_capacity.load(std::memory_order_relaxed);
+                if(m_fullPolicy.load(std::memory_order_relaxed) != QUEUE_FULL_BLOCK || count > capacity)
+                {
+                    return FALSE;
+                }
+                DWORD dwTimeout = m_dwFullTimeout.load(std::memory_order_relaxed);
+
+                size_t queued = 0;
+                BOOL bReserved;
+                {
+                    std::unique_lock<std::mutex> lock(m_spaceMutex);
+
+                    // The owner only takes the lock to wake producers once it sees one waiting
+                    m_waitingProducers.fetch_add(1, std::memory_order_seq_cst);
+                    auto hasRoom = [&]() { return tryReserve(count, m_capacity.load(std::memory_order_relaxed), queued); };
+                    if(dwTimeout == INFINITE)
+                    {
+                        m_spaceAvailable.wait(lock, hasRoom);
+                        bReserved = TRUE;
+                    }
+                    else
+                    {
+                        bReserved = m_spaceAvailable.wait_for(lock, std::chrono::milliseconds(dwTimeout), hasRoom);
+                    }
+                    m_waitingProducers.fetch_sub(1, std::memory_order_seq_cst);
+                }
+                if(bReserved)
+                {
+                    checkHighWatermark(queued);
+                }
+                return bReserved;
+            }
+
+            /*!
+            ** @brief Returns room taken by popped calls, waking any producers waiting for it. Called by the 
+            **        owning thread, and by producers which fail to push calls they reserved room for.
+            */
+            void release(size_t count)
+            {
+                size_t queued = m_queuedCount.fetch_sub(count, std::memory_order_seq_cst) - count;
+                if(m_waitingProducers.load(std::memory_order_seq_cst) != 0)
+                {
+                    std::lock_guard<std::mutex> lock(m_spaceMutex);
+                    m_spaceAvailable.notify_all();
+                }
+                if(m_bAboveHighWatermark.load(std::memory_order_relaxed) && 
+                   queued <= m_lowWatermark.load(std::memory_order_relaxed) &&
+                   m_bAboveHighWatermark.exchange(FALSE, std::memory_order_relaxed))
+                {
+                    notifyWatermark(FALSE);
+                }
+            }
+
+            /*!
+            ** @brief Remembers queued calls as candidates for dropping, under QUEUE_FULL_DROP_OLDEST. May be 
+            **        called from any thread.
+            ** @param[in] first, last a range of handlers, or of smart pointers to handlers, in the order they're queued.
+            */
+            template<class Iterator>
+            void trackDroppable(Iterator first, Iterator last)
+            {
+                if(m_fullPolicy.load(std::memory_order_relaxed) != QUEUE_FULL_DROP_OLDEST)
+                {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(m_spaceMutex);
+                size_t capacity = m_capacity.load(std::memory_order_relaxed);
+                if(capacity == 0)
+                {
+                    return;
+                }
+
+                // Calls are mostly run in the order they were queued, so those already dealt with gather at 
+                // the front. Any stragglers are swept out once they outnumber the calls which can be queued.
+                while(!m_droppable.empty() && !m_droppable.front()->isQueued())
+                {
+                    releaseDroppable(1);
+                }
+                if(m_droppable.size() > 2 * capacity)
+                {
+                    DROPPABLECALLS::iterator it = std::stable_partition(m_droppable.begin(), m_droppable.end(), 
+                                                                         [](CallHandler* p) { return !p->isQueued(); });
+                    releaseDroppable(std::distance(m_droppable.begin(), it));
+                }
+
+                // Either all the calls are tracked, or none are
+                size_t tracked = 0;
+                try
+                {
+                    for(Iterator it = first; it != last; ++it, ++tracked)
+                    {
+                        m_droppable.push_back(&**it);
+                    }
+                }
+                catch(...)
+                {
+                    m_droppable.erase(m_droppable.end() - tracked, m_droppable.end());
+                    throw;
+                }
+                for(; first != last; ++first)
+                {
+                    intrusive_ptr_add_ref(&**first);
+                }
+            }
+
+        private:
+            /*!
+            ** @brief Cancels a handler taken off the mailbox without being popped, and releases the room and
+            **        the reference it held. A coalesced handler takes the handler attached to it along.
+            */
+            void discard(CallHandler* pCallHandler)
+            {
+                if(pCallHandler->isCoalesced())
+                {
+                    abandonCoalesced(pCallHandler);
+                }
+
+                // A handler dropped by a producer has already given up its room
+                pCallHandler->cancel();
+                if(!pCallHandler->isDropped())
+                {
+                    release(1);
+                }
+                intrusive_ptr_release(pCallHandler);
+            }
+
+            /*!
+            ** @brief Takes room for count calls, unless that would exceed capacity.
+            */
+            BOOL tryReserve(size_t count, size_t capacity, size_t& queued)
+            {
+                queued = m_queuedCount.load(std::memory_order_relaxed);
+                do
+                {
+                    if(capacity != 0 && queued + count > capacity)
+                    {
+                        return FALSE;
+                    }
+                } while(!m_queuedCount.compare_exchange_weak(queued, queued + count, std::memory_order_seq_cst, std::memory_order_relaxed));
+                queued += count;
+                return TRUE;
+            }
+
+            /*!
+            ** @brief Drops the oldest queued calls until there is room for count more.
+            */
+            BOOL dropFor(size_t count, size_t capacity, size_t& queued)
+            {
+                if(count > capacity)
+                {
+                    return FALSE;
+                }
+                std::lock_guard<std::mutex> lock(m_spaceMutex);
+                while(!tryReserve(count, capacity, queued))
+                {
+                    if(m_droppable.empty())
+                    {
+                        return FALSE;
+                    }
+
+                    // A dropped call gives its room up right away. The owner skips it when it's popped. 
+                    if(m_droppable.front()->drop())
+                    {
+                        m_queuedCount.fetch_sub(1, std::memory_order_seq_cst);
+                    }
+                    releaseDroppable(1);
+                }
+                return TRUE;
+            }
+
+            /*!
+            ** @brief Forgets the first count drop candidates. m_spaceMutex must be held.
+            */
+            void releaseDroppable(size_t count)
+            {
+                for(size_t i = 0; i < count; ++i)
+                {
+                    intrusive_ptr_release(m_droppable.front());
+                    m_droppable.pop_front();
+                }
+            }
+
+            void checkHighWatermark(size_t queued)
+            {
+                size_t highWatermark = m_highWatermark.load(std::memory_order_relaxed);
+                if(highWatermark != 0 && queued >= highWatermark && 
+                   !m_bAboveHighWatermark.load(std::memory_order_relaxed) &&
+                   !m_bAboveHighWatermark.exchange(TRUE, std::memory_order_relaxed))
+                {
+                    notifyWatermark(TRUE);
+                }
+            }
+
+            void notifyWatermark(BOOL bAboveHighWatermark)
+            {
+                // The callback runs without the lock held, so that it may schedule calls itself
+                boost::function<void (BOOL)> callback;
+                {
+                    std::lock_guard<std::mutex> lock(m_spaceMutex);
+                    callback = m_watermarkCallback;
+                }
+                if(callback)
+                {
+                    callback(bAboveHighWatermark);
+                }
+            }
+
+            void collectLane(size_t laneIndex)
+            {
+                CallHandler* pPushed = m_pushedLanes[laneIndex].pPushed.exchange(NULL, std::memory_order_seq_cst);
+                if(pPushed == NULL)
+                {
+                    return;
+                }
+
+                // Reverse the detached stack into scheduling order
+                CallHandler* pNewest = pPushed;
+                CallHandler* pOldest = NULL;
+                while(pPushed != NULL)
+                {
+                    CallHandler* pNext = pPushed->m_pNextQueued;
+                    pPushed->m_pNextQueued = pOldest;
+                    pOldest = pPushed;
+                    pPushed = pNext;
+                }
+
+                PendingLane& lane = m_pendingLanes[laneIndex];
+                if(m_bDeadlineOrdering.load(std::memory_order_relaxed))
+                {
+                    // Both lists are sorted stably, so calls with equal deadlines keep their scheduling order
+                    lane.pPending = mergeByDeadline(lane.pPending, sortByDeadline(pOldest), &lane.pPendingTail);
+                    return;
+                }
+
+                if(lane.pPending == NULL)
+                {
+                    lane.pPending = pOldest;
+                }
+                else
+                {
+                    lane.pPendingTail->m_pNextQueued = pOldest;
+                }
+                lane.pPendingTail = pNewest;
+            }
+
+            /*!
+            ** @brief Merge sorts a NULL terminated list of handlers by deadline, keeping the order of equals.
+            */
+            static CallHandler* sortByDeadline(CallHandler* pList)
+            {
+                if(pList == NULL || pList->m_pNextQueued == NULL)
+                {
+                    return pList;
+                }
+
+                // Split the list in the middle
+                CallHandler* pMiddle = pList;
+                for(CallHandler* pFast = pList->m_pNextQueued; pFast != NULL && pFast->m_pNextQueued != NULL; pFast = pFast->m_pNextQueued->m_pNextQueued)
+                {
+                    pMiddle = pMiddle->m_pNextQueued;
+                }
+                CallHandler* pSecondHalf = pMiddle->m_pNextQueued;
+                pMiddle->m_pNextQueued = NULL;
+
+                CallHandler* pTail;
+                return mergeByDeadline(sortByDeadline(pList), sortByDeadline(pSecondHalf), &pTail);
+            }
+
+            /*!
+            ** @brief Merges two lists sorted by deadline. Of equal deadlines, those in the first list go first.
+            ** @param[out] ppTail receives the last handler of the merged list.
+            */
+            static CallHandler* mergeByDeadline(CallHandler* pFirst, CallHandler* pSecond, CallHandler** ppTail)
+            {
+                CallHandler* pHead = NULL;
+                CallHandler** ppNext = &pHead;
+                CallHandler* pLast = NULL;
+                while(pFirst != NULL && pSecond != NULL)
+                {
+                    CallHandler*& pTaken = pSecond->getDeadline() < pFirst->getDeadline() ? pSecond : pFirst;
+                    pLast = pTaken;
+                    *ppNext = pTaken;
+                    ppNext = &pTaken->m_pNextQueued;
+                    pTaken = pTaken->m_pNextQueued;
+                }
+
+                // Append the rest, and find the tail
+                *ppNext = pFirst != NULL ? pFirst : pSecond;
+                for(CallHandler* pRest = *ppNext; pRest != NULL; pRest = pRest->m_pNextQueued)
+                {
+                    pLast = pRest;
+                }
+                *ppTail = pLast;
+                return pHead;
+            }
+
+            // Written by producers, one cache line per lane
+            struct PushedLane
+            {
+                std::atomic<CallHandler*> pPushed;
+                char padding[THREADSYNCH_CACHE_LINE_SIZE - sizeof(std::atomic<CallHandler*>)];
+            };
+
+            // Only touched by the owning thread
+            struct PendingLane
+            {
+                CallHandler* pPending;
+                CallHandler* pPendingTail;
+                size_t passedOverCount;
+            };
+
+            // The id the mailbox was created for. Never changes.
+            ThreadId m_ownerThreadId;
+
+            PushedLane m_pushedLanes[CALL_PRIORITY_COUNT];
+
+            // Set by the producer which notifies the owner, and cleared by the owner when it collects
+            std::atomic<BOOL> m_bNotified;
+            char m_notifiedPadding[THREADSYNCH_CACHE_LINE_SIZE - sizeof(std::atomic<BOOL>)];
+
+            // Only touched by the owning thread
+            PendingLane m_pendingLanes[CALL_PRIORITY_COUNT];
+            BOOL m_bPickupRearmed;
+
+            // Read by the owning thread once per pickup, and rarely written
+            std::atomic<size_t> m_maxCallsPerPickup;
+            std::atomic<DWORD> m_dwMaxMicrosecondsPerPickup;
+            std::atomic<BOOL> m_bDeadlineOrdering;
+
+            // The coalesced handlers holding a place in the queue, and the latest handler attached to each
+            struct CoalescedCall
+            {
+                CallHandler* pQueued;
+                CallHandler* pLatest;
+            };
+            typedef std::map<ULONG_PTR, CoalescedCall> COALESCEDCALLS;
+
+            std::mutex m_coalescingMutex;
+            COALESCEDCALLS m_coalescedCalls;
+
+            // The number of calls queued, counted by producers and the owner alike
+            std::atomic<size_t> m_queuedCount;
+            std::atomic<long> m_waitingProducers;
+            char m_queuedCountPadding[THREADSYNCH_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(std::atomic<long>)];
+
+            // The capacity and watermarks, read on every push, and rarely written
+            std::atomic<size_t> m_capacity;
+            std::atomic<long> m_fullPolicy;
+            std::atomic<DWORD> m_dwFullTimeout;
+            std::atomic<size_t> m_highWatermark;
+            std::atomic<size_t> m_lowWatermark;
+            std::atomic<BOOL> m_bAboveHighWatermark;
+
+            // Guards the drop candidates and the watermark callback, and is what blocked producers wait on
+            typedef std::deque<CallHandler*> DROPPABLECALLS;
+            std::mutex m_spaceMutex;
+            std::condition_variable m_spaceAvailable;
+            DROPPABLECALLS m_droppable;
+            boost::function<void (BOOL)> m_watermarkCallback;
+
+            // Written by synchronous callers as their calls complete
+            AdaptiveSpin m_syncSpin;
+
+            // Pumping waits. The depth is only changed by the owning thread, but read by producers.
+            std::atomic<BOOL> m_bPumpingWaits;
+            std::atomic<long> m_pumpingDepth;
+            CompletionEvent m_pumpEvent;
+
+            // The mailbox of the thread the owner blocks on, or NULL
+            std::atomic<Mailbox*> m_pWaitingFor;
+            static const size_t MAX_WAIT_CHAIN = 64;
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include "PickupPolicyProvider.h"
+
+namespace ThreadSynch
+{
+    /*!@class ManualPickupPolicy
+    ** @brief A pickup policy for dedicated worker threads, which run their calls by pumping them.
+    ** @remark
+    **   The target thread loops on scheduler->pump(timeout, maxCalls), which parks the thread on its own
+    **   mailbox until calls arrive, and then runs them. The producer which finds the thread parked wakes it
+    **   directly, so a call costs the push onto the mailbox, and at most one wake-up. Nothing is queued
+    **   with the operating system, and no thread needs to be registered.
+    **
+    **   The policy itself has nothing to do. Calls scheduled to a thread which never pumps simply wait in
+    **   its mailbox, as they would for an APC thread which never enters an alertable wait.
+    */
+    class ManualPickupPolicy : public PickupPolicyProvider
+    {
+    public:
+        static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+        {
+            /* The thread finds its calls in its mailbox the next time it pumps */
+        }
+    };
+}
\ No newline at end of file
@@ -27,7 +27,7 @@ namespace ThreadSynch
 	{
 	public:
 		typedef void (APIENTRY *PCALLBACK)(ULONG_PTR ulpFunctionParameter);
-		static void scheduleThreadCallback(DWORD dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter);
+		static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter);
 
 	private:
 		PickupPolicyProvider();
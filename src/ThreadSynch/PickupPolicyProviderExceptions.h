@@ -29,10 +29,17 @@ namespace ThreadSynch
 	{
 	public:
 		PickupSchedulingFailedException()
+			: m_what("PickupSchedulingFailedException")
 		{}
 
 		PickupSchedulingFailedException(const char *const& _What)
-			: std::exception(_What)
+			: m_what(_What)
 		{}
+
+		virtual const char* what() const throw()
+		{ return m_what; }
+
+	private:
+		const char* m_what;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+/************************************************************************
+** Platform abstraction. On Windows this pulls in windows.h; on POSIX
+** systems it provides the handful of Win32 types and constants the
+** library's public interface is expressed in, so that call sites read
+** the same on every platform.
+*/
+
+#include <stdint.h>
+
+#ifdef _WIN32
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x501
+#endif
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <intrin.h>
+
+#else
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef uintptr_t ULONG_PTR;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#ifndef INFINITE
+#define INFINITE 0xFFFFFFFF
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#endif
+
+namespace ThreadSynch
+{
+    /*!
+    ** @brief Identifies a thread which calls can be scheduled to.
+    ** @remark
+    **   On Windows this is the id returned by GetCurrentThreadId. On Linux it is the kernel
+    **   thread id (gettid), which, unlike pthread_t, is a small integer and unique system wide.
+    */
+#ifdef _WIN32
+    typedef DWORD ThreadId;
+#else
+    typedef pid_t ThreadId;
+#endif
+
+    namespace details
+    {
+        /*!
+        ** @return The ThreadId of the calling thread.
+        */
+        inline ThreadId getCurrentThreadId()
+        {
+#ifdef _WIN32
+            return ::GetCurrentThreadId();
+#else
+            // The syscall is cheap, but not free. Cache it per thread.
+            static thread_local ThreadId tid = 0;
+            if(tid == 0)
+            {
+                tid = static_cast<ThreadId>(syscall(SYS_gettid));
+            }
+            return tid;
+#endif
+        }
+
+        /*!
+        ** @brief Hints to the processor that the caller is spinning, which saves power, and frees the
+        **        core up for a hyperthreaded sibling, such as the thread being waited for.
+        */
+        inline void cpuRelax()
+        {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+            _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#endif
+        }
+    }
+}
\ No newline at end of file
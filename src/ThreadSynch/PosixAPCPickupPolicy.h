@@ -0,0 +1,213 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <errno.h>
+#include "PickupPolicyProvider.h"
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        /*!@class APCQueue
+        ** @brief A per-thread queue of pending callbacks, with an eventfd which becomes readable
+        **        whenever callbacks are queued.
+        */
+        class APCQueue : private boost::noncopyable
+        {
+        public:
+            typedef PickupPolicyProvider::PCALLBACK PCALLBACK;
+
+            APCQueue()
+                : m_eventFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+            {
+                if(m_eventFd == -1)
+                {
+                    throw PickupSchedulingFailedException("eventfd creation failed");
+                }
+            }
+
+            ~APCQueue()
+            {
+                close(m_eventFd);
+            }
+
+            void queue(PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_pendingCallbacks.push_back(std::make_pair(pCallbackFunction, ulpFunctionParameter));
+                }
+
+                uint64_t increment = 1;
+                if(write(m_eventFd, &increment, sizeof(increment)) != sizeof(increment))
+                {
+                    throw PickupSchedulingFailedException("eventfd write failed");
+                }
+            }
+
+            /*!
+            ** @brief Waits for callbacks to be queued, and runs them.
+            ** @return TRUE if any callbacks were run, FALSE if the wait timed out.
+            */
+            BOOL wait(DWORD dwTimeout)
+            {
+                pollfd pfd = { m_eventFd, POLLIN, 0 };
+                int result;
+                do
+                {
+                    result = poll(&pfd, 1, dwTimeout == INFINITE ? -1 : static_cast<int>(dwTimeout));
+                } while(result == -1 && errno == EINTR);
+
+                if(result <= 0)
+                {
+                    return FALSE;
+                }
+                return run();
+            }
+
+            /*!
+            ** @brief Runs all currently queued callbacks, without waiting.
+            ** @return TRUE if any callbacks were run.
+            */
+            BOOL run()
+            {
+                uint64_t counter;
+                if(read(m_eventFd, &counter, sizeof(counter)) != sizeof(counter))
+                {
+                    return FALSE;
+                }
+
+                // Both vectors keep their capacity, so steady state pickups don't allocate
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_runningCallbacks.swap(m_pendingCallbacks);
+                }
+
+                for(size_t i = 0; i < m_runningCallbacks.size(); ++i)
+                {
+                    m_runningCallbacks[i].first(m_runningCallbacks[i].second);
+                }
+                BOOL bRan = m_runningCallbacks.empty() ? FALSE : TRUE;
+                m_runningCallbacks.clear();
+                return bRan;
+            }
+
+            int getEventFd() const
+            {
+                return m_eventFd;
+            }
+
+        private:
+            int m_eventFd;
+            std::mutex m_mutex;
+            std::vector<std::pair<PCALLBACK, ULONG_PTR>> m_pendingCallbacks;
+
+            // Only touched by the owning thread, while running callbacks
+            std::vector<std::pair<PCALLBACK, ULONG_PTR>> m_runningCallbacks;
+        };
+    }
+
+    /*!@class PosixAPCPickupPolicy
+    ** @brief A pickup policy which emulates Win32 asynchronous procedure calls on Linux.
+    ** @remark
+    **   A target thread registers itself with registerCurrentThread, and then picks up scheduled calls
+    **   whenever it enters alertableWait, much like a Win32 thread does with SleepEx or
+    **   WaitForSingleObjectEx. Scheduling a call to a thread which isn't registered fails with
+    **   PickupSchedulingFailedException, mirroring QueueUserAPC on an invalid thread.
+    */
+    class PosixAPCPickupPolicy : public PickupPolicyProvider
+    {
+    public:
+        static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+        {
+            boost::shared_ptr<details::APCQueue> pQueue = findQueue(dwThreadId);
+            if(!pQueue)
+            {
+                throw PickupSchedulingFailedException();
+            }
+            pQueue->queue(pCallbackFunction, ulpFunctionParameter);
+        }
+
+        /*!
+        ** @brief Makes the calling thread a valid target for scheduled calls.
+        ** @throw PickupSchedulingFailedException if the thread's eventfd could not be created.
+        */
+        static void registerCurrentThread()
+        {
+            boost::shared_ptr<details::APCQueue> pQueue(new details::APCQueue());
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry()[details::getCurrentThreadId()] = pQueue;
+        }
+
+        /*!
+        ** @brief Removes the calling thread from the set of valid targets. Callbacks which
+        **        have not yet been picked up are discarded.
+        */
+        static void unregisterCurrentThread()
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry().erase(details::getCurrentThreadId());
+        }
+
+        /*!
+        ** @brief Waits, alertably, for scheduled calls to arrive, and executes them.
+        ** @param[in] dwTimeout number of milliseconds to wait. Specify INFINITE to wait without timeouts.
+        ** @return TRUE if any calls were picked up, FALSE if the wait timed out.
+        ** @remark The calling thread must have been registered with registerCurrentThread.
+        */
+        static BOOL alertableWait(DWORD dwTimeout)
+        {
+            boost::shared_ptr<details::APCQueue> pQueue = findQueue(details::getCurrentThreadId());
+            if(!pQueue)
+            {
+                return FALSE;
+            }
+            return pQueue->wait(dwTimeout);
+        }
+
+    private:
+        typedef std::map<ThreadId, boost::shared_ptr<details::APCQueue>> APCQUEUEMAP;
+
+        static boost::shared_ptr<details::APCQueue> findQueue(ThreadId dwThreadId)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            APCQUEUEMAP::iterator queueIter = registry().find(dwThreadId);
+            if(queueIter == registry().end())
+            {
+                return boost::shared_ptr<details::APCQueue>();
+            }
+            return queueIter->second;
+        }
+
+        // The registry is intentionally never destroyed, as registered threads may well outlive
+        // static destruction.
+        static APCQUEUEMAP& registry()
+        {
+            static APCQUEUEMAP* pQueues = new APCQUEUEMAP();
+            return *pQueues;
+        }
+
+        static std::mutex& registryMutex()
+        {
+            static std::mutex* pMutex = new std::mutex();
+            return *pMutex;
+        }
+    };
+}
\ No newline at end of file
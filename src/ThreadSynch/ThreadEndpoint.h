@@ -0,0 +1,208 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        class Mailbox;
+    }
+
+    template<class PickupPolicy>
+    class CallScheduler;
+
+    /*!
+    ** @brief The priority of a scheduled call. Each target thread runs its calls highest priority first,
+    **   and calls of the same priority in the order they were scheduled.
+    */
+    enum CALL_PRIORITY
+    {
+        CALL_PRIORITY_HIGH,     //!< Interactive calls, such as those made from input handlers
+        CALL_PRIORITY_NORMAL,   //!< The default
+        CALL_PRIORITY_LOW,      //!< Bulk and background work
+        CALL_PRIORITY_COUNT
+    };
+
+    /*!@class ThreadEndpoint
+    ** @brief Identifies the target of a scheduled call.
+    ** @remark
+    **   An endpoint obtained from CallScheduler::getEndpoint is resolved: it points straight at the
+    **   target thread's mailbox, so calls made through it skip the thread lookup entirely. Endpoints
+    **   are cheap to copy, and stay valid for the lifetime of the scheduler which resolved them.
+    **
+    **   A ThreadId converts implicitly to an unresolved endpoint, which is looked up on every call.
+    **   This is what keeps the ThreadId based syncCall and asyncCall call sites working.
+    **
+    **   The endpoint also carries the priority of the calls made through it, CALL_PRIORITY_NORMAL unless
+    **   specified otherwise, as in scheduler->syncCall(endpoint.withPriority(CALL_PRIORITY_HIGH), ...),
+    **   and optionally a deadline by which those calls must be picked up. Finally, it tells whether or not
+    **   a caller which pumps its own calls while it waits may do so while waiting for these calls, and
+    **   whether or not synchronous callers check that the wait can't deadlock.
+    */
+    class ThreadEndpoint
+    {
+    public:
+        /*!
+        ** @brief Constructs an unresolved endpoint for the specified thread.
+        */
+        ThreadEndpoint(ThreadId dwThreadId)
+            : m_dwThreadId(dwThreadId),
+              m_pMailbox(NULL),
+              m_pOwner(NULL),
+              m_priority(CALL_PRIORITY_NORMAL),
+              m_dwDeadline(INFINITE),
+              m_bPumpingAllowed(TRUE),
+              m_bDeadlockDetection(TRUE)
+        {}
+
+        /*!
+        ** @brief Constructs an unresolved endpoint for the specified thread, with the specified call priority.
+        */
+        ThreadEndpoint(ThreadId dwThreadId, CALL_PRIORITY priority)
+            : m_dwThreadId(dwThreadId),
+              m_pMailbox(NULL),
+              m_pOwner(NULL),
+              m_priority(priority),
+              m_dwDeadline(INFINITE),
+              m_bPumpingAllowed(TRUE),
+              m_bDeadlockDetection(TRUE)
+        {}
+
+        /*!
+        ** @return A copy of the endpoint, which schedules calls with the specified priority.
+        */
+        ThreadEndpoint withPriority(CALL_PRIORITY priority) const
+        {
+            ThreadEndpoint endpoint(*this);
+            endpoint.m_priority = priority;
+            return endpoint;
+        }
+
+        /*!
+        ** @return The priority of calls made through the endpoint.
+        */
+        CALL_PRIORITY getPriority() const
+        {
+            return m_priority;
+        }
+
+        /*!
+        ** @return A copy of the endpoint, whose calls must be picked up within the specified time of being 
+        **   scheduled. Calls still queued past their deadline are discarded by the target thread, unrun,
+        **   and their Futures report ASYNCH_CALL_ABORTED.
+        ** @param[in] dwDeadline number of milliseconds, or INFINITE for no deadline.
+        */
+        ThreadEndpoint withDeadline(DWORD dwDeadline) const
+        {
+            ThreadEndpoint endpoint(*this);
+            endpoint.m_dwDeadline = dwDeadline;
+            return endpoint;
+        }
+
+        /*!
+        ** @return The deadline of calls made through the endpoint, in milliseconds from scheduling, or INFINITE.
+        */
+        DWORD getDeadline() const
+        {
+            return m_dwDeadline;
+        }
+
+        /*!
+        ** @return A copy of the endpoint, whose callers never run other calls while they wait, even if their
+        **   thread pumps its calls while waiting. For calls made from code which isn't reentrant.
+        ** @sa CallScheduler::setPumpingWaits
+        */
+        ThreadEndpoint withoutPumping() const
+        {
+            ThreadEndpoint endpoint(*this);
+            endpoint.m_bPumpingAllowed = FALSE;
+            return endpoint;
+        }
+
+        /*!
+        ** @return Whether or not callers may run their own thread's calls while they wait for calls made
+        **   through the endpoint.
+        */
+        BOOL isPumpingAllowed() const
+        {
+            return m_bPumpingAllowed;
+        }
+
+        /*!
+        ** @return A copy of the endpoint, whose synchronous callers don't track what they wait for, and
+        **   won't see CallDeadlockException. For call paths which can't form a cycle, and would rather not
+        **   pay for the tracking.
+        */
+        ThreadEndpoint withoutDeadlockDetection() const
+        {
+            ThreadEndpoint endpoint(*this);
+            endpoint.m_bDeadlockDetection = FALSE;
+            return endpoint;
+        }
+
+        /*!
+        ** @return Whether or not synchronous callers check for deadlocks before they block on the target thread.
+        */
+        BOOL isDeadlockDetectionEnabled() const
+        {
+            return m_bDeadlockDetection;
+        }
+
+        /*!
+        ** @return The id of the target thread.
+        */
+        ThreadId getThreadId() const
+        {
+            return m_dwThreadId;
+        }
+
+        /*!
+        ** @return Whether or not the endpoint has been resolved by a scheduler.
+        */
+        BOOL isResolved() const
+        {
+            return m_pMailbox != NULL;
+        }
+
+    private:
+        template<class PickupPolicy>
+        friend class CallScheduler;
+
+        ThreadEndpoint(ThreadId dwThreadId, details::Mailbox* pMailbox, const void* pOwner)
+            : m_dwThreadId(dwThreadId),
+              m_pMailbox(pMailbox),
+              m_pOwner(pOwner),
+              m_priority(CALL_PRIORITY_NORMAL),
+              m_dwDeadline(INFINITE),
+              m_bPumpingAllowed(TRUE),
+              m_bDeadlockDetection(TRUE)
+        {}
+
+        ThreadId m_dwThreadId;
+        details::Mailbox* m_pMailbox;
+
+        // The scheduler which resolved the endpoint. An endpoint passed to another scheduler
+        // instance is treated as unresolved.
+        const void* m_pOwner;
+
+        CALL_PRIORITY m_priority;
+        DWORD m_dwDeadline;
+        BOOL m_bPumpingAllowed;
+        BOOL m_bDeadlockDetection;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        /*!@class ThreadRegistry
+        ** @brief A concurrent map from ThreadId to a per-thread object of type T.
+        ** @remark
+        **   The registry is split into THREADSYNCH_REGISTRY_SHARDS shards, each of which is an open
+        **   addressing hash table with linear probing. Lookups never lock: they hash the id, load the
+        **   shard's current table and probe a few slots. Inserts lock the shard, and grow it by
+        **   publishing a copy of twice the size. Replaced tables are kept until the registry is
+        **   destroyed, so a lookup racing with a resize always probes valid memory.
+        **
+        **   Entries are never removed. The operating system recycles thread ids, so the next thread to
+        **   get the same id inherits the entry, and the registry stays bounded by the peak number of
+        **   threads ever targeted. Whatever state the previous thread left in the object is the owner's to
+        **   reset, as CallScheduler::registerCurrentThread does with a mailbox. Thread id 0 is reserved to
+        **   mark empty slots. Each object is constructed from the id it is created for.
+        */
+        template<class T>
+        class ThreadRegistry : private boost::noncopyable
+        {
+        public:
+            ThreadRegistry()
+            {
+                for(size_t i = 0; i < THREADSYNCH_REGISTRY_SHARDS; ++i)
+                {
+                    m_shards[i].pTable.store(new Table(INITIAL_SHARD_CAPACITY, NULL), std::memory_order_relaxed);
+                    m_shards[i].entryCount = 0;
+                }
+            }
+
+            /*!
+            ** @brief Destroys the registry, along with every object it holds.
+            */
+            ~ThreadRegistry()
+            {
+                for(size_t i = 0; i < THREADSYNCH_REGISTRY_SHARDS; ++i)
+                {
+                    Table* pTable = m_shards[i].pTable.load(std::memory_order_relaxed);
+                    for(size_t slot = 0; slot <= pTable->mask; ++slot)
+                    {
+                        delete pTable->pSlots[slot].pValue.load(std::memory_order_relaxed);
+                    }
+                    while(pTable != NULL)
+                    {
+                        Table* pRetired = pTable->pRetired;
+                        delete pTable;
+                        pTable = pRetired;
+                    }
+                }
+            }
+
+            /*!
+            ** @brief Looks up the object of a thread. Never locks.
+            ** @return The object, or NULL if the thread has no entry.
+            */
+            T* find(ThreadId dwThreadId) const
+            {
+                uint64_t hash = hashThreadId(dwThreadId);
+                const Table* pTable = getShard(hash).pTable.load(std::memory_order_acquire);
+                for(size_t slot = static_cast<size_t>(hash) & pTable->mask; ; slot = (slot + 1) & pTable->mask)
+                {
+                    ThreadId key = pTable->pSlots[slot].key.load(std::memory_order_acquire);
+                    if(key == dwThreadId)
+                    {
+                        return pTable->pSlots[slot].pValue.load(std::memory_order_relaxed);
+                    }
+                    if(key == 0)
+                    {
+                        return NULL;
+                    }
+                }
+            }
+
+            /*!
+            ** @brief Looks up the object of a thread, and default constructs one if there is none.
+            ** @remark Only the first call for any given thread takes a lock.
+            ** @throw std::bad_alloc if the object or a grown table could not be allocated.
+            */
+            T* findOrCreate(ThreadId dwThreadId)
+            {
+                T* pValue = find(dwThreadId);
+                if(pValue != NULL)
+                {
+                    return pValue;
+                }
+
+                uint64_t hash = hashThreadId(dwThreadId);
+                Shard& shard = getShard(hash);
+                std::lock_guard<std::mutex> lock(shard.mutex);
+
+                // Another thread may have inserted the entry while the lock was being acquired
+                if((pValue = find(dwThreadId)) != NULL)
+                {
+                    return pValue;
+                }
+
+                // Keep the load factor at or below one half, so probe sequences stay short
+                Table* pTable = shard.pTable.load(std::memory_order_relaxed);
+                if((shard.entryCount + 1) * 2 > pTable->mask + 1)
+                {
+                    pTable = grow(shard, pTable);
+                }
+
+                std::unique_ptr<T> pNewValue(new T(dwThreadId));
+                insert(pTable, dwThreadId, hash, pNewValue.get());
+                ++shard.entryCount;
+                return pNewValue.release();
+            }
+
+        private:
+            static const size_t INITIAL_SHARD_CAPACITY = 16;
+
+            struct Slot
+            {
+                std::atomic<ThreadId> key;
+                std::atomic<T*> pValue;
+            };
+
+            struct Table
+            {
+                Table(size_t capacity, Table* pRetiredTable)
+                    : mask(capacity - 1),
+                      pSlots(new Slot[capacity]),
+                      pRetired(pRetiredTable)
+                {
+                    for(size_t slot = 0; slot < capacity; ++slot)
+                    {
+                        pSlots[slot].key.store(0, std::memory_order_relaxed);
+                        pSlots[slot].pValue.store(NULL, std::memory_order_relaxed);
+                    }
+                }
+
+                ~Table()
+                {
+                    delete[] pSlots;
+                }
+
+                const size_t mask;
+                Slot* const pSlots;
+                Table* const pRetired;
+            };
+
+            struct Shard
+            {
+                std::atomic<Table*> pTable;
+                std::mutex mutex;
+                size_t entryCount;
+                char padding[THREADSYNCH_CACHE_LINE_SIZE];
+            };
+
+            Shard m_shards[THREADSYNCH_REGISTRY_SHARDS];
+
+            static uint64_t hashThreadId(ThreadId dwThreadId)
+            {
+                // Fibonacci hashing spreads the mostly sequential thread ids across slots and shards
+                uint64_t hash = static_cast<uint64_t>(dwThreadId) * 0x9E3779B97F4A7C15ULL;
+                return hash ^ (hash >> 32);
+            }
+
+            Shard& getShard(uint64_t hash)
+            {
+                return m_shards[(hash >> 48) % THREADSYNCH_REGISTRY_SHARDS];
+            }
+
+            const Shard& getShard(uint64_t hash) const
+            {
+                return m_shards[(hash >> 48) % THREADSYNCH_REGISTRY_SHARDS];
+            }
+
+            // Must be called with the shard locked
+            static void insert(Table* pTable, ThreadId dwThreadId, uint64_t hash, T* pValue)
+            {
+                size_t slot = static_cast<size_t>(hash) & pTable->mask;
+                while(pTable->pSlots[slot].key.load(std::memory_order_relaxed) != 0)
+                {
+                    slot = (slot + 1) & pTable->mask;
+                }
+
+                // The value is published before the key, so a reader that sees the key also sees the value
+                pTable->pSlots[slot].pValue.store(pValue, std::memory_order_relaxed);
+                pTable->pSlots[slot].key.store(dwThreadId, std::memory_order_release);
+            }
+
+            // Must be called with the shard locked
+            static Table* grow(Shard& shard, Table* pTable)
+            {
+                Table* pGrownTable = new Table((pTable->mask + 1) * 2, pTable);
+                for(size_t slot = 0; slot <= pTable->mask; ++slot)
+                {
+                    ThreadId key = pTable->pSlots[slot].key.load(std::memory_order_relaxed);
+                    if(key != 0)
+                    {
+                        insert(pGrownTable, key, hashThreadId(key), pTable->pSlots[slot].pValue.load(std::memory_order_relaxed));
+                    }
+                }
+                shard.pTable.store(pGrownTable, std::memory_order_release);
+                return pGrownTable;
+            }
+        };
+    }
+}
\ No newline at end of file
@@ -22,29 +22,80 @@
 #define THREADSYNCH_MAX_EXPECTED_EXCEPTIONS 10
 #endif 
 
-// Windows headers and defines
+#ifndef THREADSYNCH_CACHE_LINE_SIZE
+#define THREADSYNCH_CACHE_LINE_SIZE 64
+#endif
+
+#ifndef THREADSYNCH_REGISTRY_SHARDS
+#define THREADSYNCH_REGISTRY_SHARDS 16
+#endif
+
+#ifndef THREADSYNCH_PARKING_LOT_SIZE
+#define THREADSYNCH_PARKING_LOT_SIZE 64
+#endif
+
+#ifndef THREADSYNCH_FRAME_POOL_CLASSES
+#define THREADSYNCH_FRAME_POOL_CLASSES 8
+#endif
+
+#ifndef THREADSYNCH_FRAME_POOL_DEPTH
+#define THREADSYNCH_FRAME_POOL_DEPTH 256
+#endif
+
+#ifndef THREADSYNCH_FUNCTION_BUFFER_SIZE
+#define THREADSYNCH_FUNCTION_BUFFER_SIZE 48
+#endif
+
+#ifndef THREADSYNCH_PRIORITY_AGING
+#define THREADSYNCH_PRIORITY_AGING 16
+#endif
+
+#ifndef THREADSYNCH_MAX_SPIN_MICROSECONDS
+#define THREADSYNCH_MAX_SPIN_MICROSECONDS 50
+#endif
 
-#ifndef _WIN32_WINNT
-#define _WIN32_WINNT 0x501
+#ifndef THREADSYNCH_MAX_PUMPING_DEPTH
+#define THREADSYNCH_MAX_PUMPING_DEPTH 4
 #endif
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+// Platform headers and defines
+
+#include "Platform.h"
 
 // STL headers
 
 #include <map>
 #include <list>
+#include <deque>
+#include <vector>
+#include <utility>
 #include <algorithm>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <tuple>
+#include <functional>
+#include <iterator>
+#include <thread>
 
 // Boost headers
 
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/scoped_array.hpp>
+#include <boost/aligned_storage.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/preprocessor/repetition/repeat.hpp> 
 #include <boost/type_traits.hpp>
 #include <boost/mpl/vector.hpp>
@@ -58,4 +109,7 @@
 
 // ThreadSynch headers
 
+#include "CompletionEvent.h"
+#include "ThreadRegistry.h"
+#include "ThreadEndpoint.h"
 #include "CallScheduler.h"
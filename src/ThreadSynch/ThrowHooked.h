@@ -21,42 +21,34 @@ namespace ThreadSynch
 	namespace details
 	{
 		/*!
-		** @brief A function which throws an exception object with an attached on-cleanup functor.
+		** @brief A function which throws an exception object with an attached owner.
 		** @param[in] orig the exception object to be thrown.
-		** @param[in] onDeathFunctor a functor, with return type void and no parameters, which will be
-		**   executed when the exception object is destroyed.
+		** @param[in] owner a copyable object, such as a smart pointer, which the exception object holds
+		**   on to for as long as it lives.
 		** @remark
 		**   The function will create a dummy class which wraps the exception object to be thrown.
 		**   When the exception object is free'd, which is usually when the catch block is completed, 
-		**   the functor will be executed.
+		**   the owner is released along with it.
 		*/
-		template<class T>
-		void throwHooked(const T& orig, boost::function<void()>& onDeathFunctor)
+		template<class T, class Owner>
+		void throwHooked(const T& orig, const Owner& owner)
 		{
 			#pragma warning(push)
 			#pragma warning(disable: 4512)
 			class ExHook : public T
 			{
 			public:
-				ExHook(const T& other, const boost::function<void()>& onDeathFunctor) 
+				ExHook(const T& other, const Owner& owner) 
 					: T(other), 
-					  m_onDeathFunctor(onDeathFunctor) 
+					  m_owner(owner) 
 				{}
 
-				ExHook(const ExHook& other) 
-					: T(other),
-					  m_onDeathFunctor(other.m_onDeathFunctor) 
-				{}
-
-				~ExHook() 
-				{ m_onDeathFunctor(); }
-
 			private:
-				const boost::function<void()> m_onDeathFunctor;
+				const Owner m_owner;
 			};
 			#pragma warning(pop)
 
-			throw ExHook(orig, onDeathFunctor);
+			throw ExHook(orig, owner);
 		}
 
 	}
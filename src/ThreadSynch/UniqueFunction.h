@@ -0,0 +1,228 @@
+/************************************************************************
+** Copyright 2007 Einar Otto Stangvik
+** 
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+** 
+**    http://www.apache.org/licenses/LICENSE-2.0
+** 
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#pragma once
+
+namespace ThreadSynch
+{
+    namespace details
+    {
+        template<typename Signature>
+        class UniqueFunction; // not implemented
+
+        /*!@class UniqueFunction
+        ** @brief A move-only, type erased callable with inline storage.
+        ** @remark
+        **   Callables of up to THREADSYNCH_FUNCTION_BUFFER_SIZE bytes which can be moved without throwing
+        **   are stored inline. Larger ones are moved to the heap. Invoking the function is a single
+        **   indirect call, and an empty function throws boost::bad_function_call without an extra test
+        **   on the call path.
+        **
+        **   Unlike boost::function, a UniqueFunction never copies its target. It is moved into place once,
+        **   and may hold callables which cannot be copied at all.
+        */
+        template<typename R, typename... Args>
+        class UniqueFunction<R(Args...)>
+        {
+        public:
+            /*!
+            ** @brief Constructs an empty function.
+            */
+            UniqueFunction()
+                : m_pInvoke(&invokeEmpty),
+                  m_pManage(NULL)
+            {}
+
+            /*!
+            ** @brief Constructs a function which takes ownership of the specified callable.
+            ** @throw std::bad_alloc if the callable doesn't fit inline, and couldn't be allocated.
+            */
+            template<class F>
+            UniqueFunction(F&& functor, typename boost::disable_if<boost::is_same<typename std::decay<F>::type, UniqueFunction>>::type* = 0)
+            {
+                typedef typename std::decay<F>::type FunctorType;
+                typedef Manager<FunctorType, IsStoredInline<FunctorType>::value> ManagerType;
+                ManagerType::construct(m_storage, std::forward<F>(functor));
+                m_pInvoke = &ManagerType::invoke;
+                m_pManage = &ManagerType::manage;
+            }
+
+            UniqueFunction(UniqueFunction&& other)
+                : m_pInvoke(other.m_pInvoke),
+                  m_pManage(other.m_pManage)
+            {
+                if(m_pManage != NULL)
+                {
+                    m_pManage(Operation_Move, other.m_storage, &m_storage);
+                    other.m_pInvoke = &invokeEmpty;
+                    other.m_pManage = NULL;
+                }
+            }
+
+            UniqueFunction& operator =(UniqueFunction&& other)
+            {
+                if(this != &other)
+                {
+                    UniqueFunction(std::move(other)).swap(*this);
+                }
+                return *this;
+            }
+
+            ~UniqueFunction()
+            {
+                clear();
+            }
+
+            /*!
+            ** @brief Invokes the stored callable.
+            ** @throw boost::bad_function_call if the function is empty.
+            */
+            R operator()(Args... args) const
+            {
+                return m_pInvoke(m_storage, std::forward<Args>(args)...);
+            }
+
+            /*!
+            ** @return Whether or not the function is empty.
+            */
+            BOOL empty() const
+            {
+                return m_pManage == NULL;
+            }
+
+            /*!
+            ** @brief Destroys the stored callable, along with anything it has bound, leaving the function empty.
+            */
+            void clear()
+            {
+                if(m_pManage != NULL)
+                {
+                    m_pManage(Operation_Destroy, m_storage, NULL);
+                    m_pInvoke = &invokeEmpty;
+                    m_pManage = NULL;
+                }
+            }
+
+            void swap(UniqueFunction& other)
+            {
+                // Stored callables are nothrow movable, so the exchange goes through a temporary buffer
+                Storage temporary;
+                if(other.m_pManage != NULL)
+                {
+                    other.m_pManage(Operation_Move, other.m_storage, &temporary);
+                }
+                if(m_pManage != NULL)
+                {
+                    m_pManage(Operation_Move, m_storage, &other.m_storage);
+                }
+                if(other.m_pManage != NULL)
+                {
+                    other.m_pManage(Operation_Move, temporary, &m_storage);
+                }
+                std::swap(m_pInvoke, other.m_pInvoke);
+                std::swap(m_pManage, other.m_pManage);
+            }
+
+        private:
+            UniqueFunction(const UniqueFunction&); // not implemented
+            UniqueFunction& operator =(const UniqueFunction&); // not implemented
+
+            typedef typename boost::aligned_storage<THREADSYNCH_FUNCTION_BUFFER_SIZE>::type Storage;
+
+            enum Operation
+            {
+                Operation_Move,
+                Operation_Destroy
+            };
+
+            template<class F>
+            struct IsStoredInline
+            {
+                static const bool value = sizeof(F) <= sizeof(Storage) &&
+                                          boost::alignment_of<Storage>::value % boost::alignment_of<F>::value == 0 &&
+                                          std::is_nothrow_move_constructible<F>::value;
+            };
+
+            template<class F, bool bInline>
+            struct Manager;
+
+            // The callable lives in the buffer
+            template<class F>
+            struct Manager<F, true>
+            {
+                template<class G>
+                static void construct(Storage& storage, G&& functor)
+                {
+                    new (&storage) F(std::forward<G>(functor));
+                }
+
+                static R invoke(const Storage& storage, Args... args)
+                {
+                    return (*const_cast<F*>(reinterpret_cast<const F*>(&storage)))(std::forward<Args>(args)...);
+                }
+
+                static void manage(Operation operation, Storage& source, Storage* pDestination)
+                {
+                    F* pFunctor = reinterpret_cast<F*>(&source);
+                    if(operation == Operation_Move)
+                    {
+                        new (pDestination) F(std::move(*pFunctor));
+                    }
+                    pFunctor->~F();
+                }
+            };
+
+            // The buffer holds a pointer to the callable
+            template<class F>
+            struct Manager<F, false>
+            {
+                template<class G>
+                static void construct(Storage& storage, G&& functor)
+                {
+                    *reinterpret_cast<F**>(&storage) = new F(std::forward<G>(functor));
+                }
+
+                static R invoke(const Storage& storage, Args... args)
+                {
+                    return (**reinterpret_cast<F* const*>(&storage))(std::forward<Args>(args)...);
+                }
+
+                static void manage(Operation operation, Storage& source, Storage* pDestination)
+                {
+                    F*& pFunctor = *reinterpret_cast<F**>(&source);
+                    if(operation == Operation_Move)
+                    {
+                        *reinterpret_cast<F**>(pDestination) = pFunctor;
+                    }
+                    else
+                    {
+                        delete pFunctor;
+                    }
+                    pFunctor = NULL;
+                }
+            };
+
+            static R invokeEmpty(const Storage&, Args...)
+            {
+                boost::throw_exception(boost::bad_function_call());
+            }
+
+            R (*m_pInvoke)(const Storage&, Args...);
+            void (*m_pManage)(Operation, Storage&, Storage*);
+            Storage m_storage;
+        };
+    }
+}
\ No newline at end of file
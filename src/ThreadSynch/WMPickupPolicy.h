@@ -26,7 +26,7 @@ namespace ThreadSynch
 	public:
 		static const unsigned int WM_PICKUP = WindowMessageId;
 
-		static void scheduleThreadCallback(DWORD dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+		static void scheduleThreadCallback(ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
 		{
             // Note that a PostThreadMessage approach is unreliable if the window is in a modal loop, as the 
             // posted message will be lost. A far superior approach would be to write a custom policy targeting
@@ -21,10 +21,25 @@
 // Boost headers
 #include <boost/scoped_ptr.hpp>
 
+// STL headers
+#include <vector>
+#include <thread>
+#include <atomic>
+
 // ThreadSynch Headers
 #include "../ThreadSynch/ThreadSynch.h"
+#include "../ThreadSynch/ManualPickupPolicy.h"
+#include "../ThreadSynch/BusyPollPickupPolicy.h"
+#include "../ThreadSynch/AsioPickupPolicy.h"
+#ifdef _WIN32
 #include "../ThreadSynch/APCPickupPolicy.h"
+#else
+#include "../ThreadSynch/PosixAPCPickupPolicy.h"
+#include "../ThreadSynch/EventFdPickupPolicy.h"
+#include <sys/epoll.h>
+#endif
 
+#ifdef _MSC_VER
 #ifdef _DEBUG
 #pragma comment(lib, "libboost_unit_test_framework-vc80-mt-gd.lib")
 #pragma comment(lib, "libboost_test_exec_monitor-vc80-mt-gd.lib")
@@ -32,9 +47,18 @@
 #pragma comment(lib, "libboost_unit_test_framework-vc80-mt.lib")
 #pragma comment(lib, "libboost_test_exec_monitor-vc80-mt.lib")
 #endif
+#endif
 
 using namespace boost::unit_test;
 
+// The pickup policy exercised by the tests: Win32 APCs on Windows, and the
+// eventfd based APC emulation elsewhere.
+#ifdef _WIN32
+typedef ThreadSynch::APCPickupPolicy TestPickupPolicy;
+#else
+typedef ThreadSynch::PosixAPCPickupPolicy TestPickupPolicy;
+#endif
+
 /************************************************************************
 ** Test helper classes and functions
 */
@@ -59,29 +83,118 @@ public:
 };
 int SharedClass::refcount = 0;
 
+class CopyCountedPayload
+{
+public:
+    static std::atomic<int> copies;
+    CopyCountedPayload() : data(1024, 0x42) {}
+    CopyCountedPayload(const CopyCountedPayload& other) : data(other.data) { ++copies; }
+    CopyCountedPayload(CopyCountedPayload&& other) : data(std::move(other.data)) {}
+    size_t size() const { return data.size(); }
+    std::vector<int> data;
+};
+std::atomic<int> CopyCountedPayload::copies(0);
+
+// Forwards to the test pickup policy, unless a failure is set up. The next notification then runs it,
+// and fails.
+class FailingPickupPolicy : public ThreadSynch::PickupPolicyProvider
+{
+public:
+    static boost::function<void()> beforeFailure;
+    static void scheduleThreadCallback(ThreadSynch::ThreadId dwThreadId, PCALLBACK pCallbackFunction, ULONG_PTR ulpFunctionParameter)
+    {
+        if(beforeFailure)
+        {
+            boost::function<void()> failure;
+            failure.swap(beforeFailure);
+            failure();
+            throw ThreadSynch::PickupSchedulingFailedException();
+        }
+        TestPickupPolicy::scheduleThreadCallback(dwThreadId, pCallbackFunction, ulpFunctionParameter);
+    }
+};
+boost::function<void()> FailingPickupPolicy::beforeFailure;
+
+#ifdef _WIN32
 HANDLE g_hTestThread;
 HANDLE g_hCloseEvent;
 HANDLE g_hTemporarilySuspendEvent;
-DWORD g_dwThreadId;
+#else
+std::thread g_testThread;
+std::atomic<bool> g_bClose(false);
+std::atomic<bool> g_bTemporarilySuspend(false);
+std::atomic<ThreadSynch::ThreadId> g_testThreadId(0);
+
+// Counts the waits in which the test thread picked up calls. Only touched by the test thread.
+int g_pickupCycles = 0;
+
+void Sleep(DWORD dwMilliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(dwMilliseconds));
+}
+#endif
+ThreadSynch::ThreadId g_dwThreadId;
 
 void testParametersSynch();
 void testAbortSynch();
 void testExceptionsSynch();
+void testMovedReturnValuesSynch();
+void testVariadicSynch();
+void testChronoTimeoutsSynch();
+void testSameThreadSynch();
+void testPumpingWaitSynch();
+void testDeadlockDetectionSynch();
+void testTimeoutRaceSynch();
 void testReturnValuesSynch();
 void testParametersAsynch();
 void testAbortAsynch();
 void testExceptionsAsynch();
 void testReturnValuesAsynch();
-DWORD WINAPI testThread(PVOID);
+void testManyProducersAsynch();
+void testEndpointAsynch();
+void testTakeAsynch();
+void testVariadicAsynch();
+void testBatchAsynch();
+void testPickupBudgetAsynch();
+void testPriorityAsynch();
+void testDeadlinesAsynch();
+void testCoalescedAsynch();
+void testBoundedQueueAsynch();
+#ifndef _WIN32
+void testEventFdPickupAsynch();
+#endif
+void testManualPumpAsynch();
+void testBusyPollAsynch();
+void testAsioPickupAsynch();
+void testSchedulingFailureAsynch();
+#ifndef _WIN32
+void testThreadIdReuseAsynch();
+#endif
+void testThreadRegistry();
+void testCompletionEvent();
+void testFramePool();
+void testUniqueFunction();
+void testAdaptiveSpin();
+void startTestThread();
+void stopTestThread();
+void suspendTestThread();
+void registerCallingThread();
+void unregisterCallingThread();
 void makeThrowingCrossCall_DerivedBase();
 void makeThrowingCrossCall_BaseDerived();
+void makeThrowingVariadicCall();
 boost::shared_ptr<SharedClass> crossThreadPtr();
+CopyCountedPayload crossThreadPayload();
+std::unique_ptr<int> crossThreadUniquePtr(int input);
 int crossThreadIntValue(int input);
 int crossThreadIntPtr(int* input);
 int crossThreadIntRef(int& input);
 bool isRealException(const TestException& ex);
 void crossThreadException();
 void aborted();
+int abortedWithArgument(boost::shared_ptr<SharedClass> pShared);
+void recordOrderedCall(std::vector<int>& lastSeen, std::atomic<int>& outOfOrder, int producer, int sequence);
+void recordPickupCycle(std::vector<int>& cycles, size_t index);
 
 /************************************************************************
 ** Test Setup
@@ -93,34 +206,70 @@ public:
     ThreadSynchTestSuite()
         : test_suite("bleh")
     {
-        g_hCloseEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
-        g_hTemporarilySuspendEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-        g_hTestThread = CreateThread(NULL, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(testThread), NULL, 0, &g_dwThreadId);
+        startTestThread();
 
         // Synchronous test cases
         add(BOOST_TEST_CASE(&testAbortSynch));
         add(BOOST_TEST_CASE(&testParametersSynch));
         add(BOOST_TEST_CASE(&testReturnValuesSynch));
         add(BOOST_TEST_CASE(&testExceptionsSynch));
+        add(BOOST_TEST_CASE(&testMovedReturnValuesSynch));
+        add(BOOST_TEST_CASE(&testVariadicSynch));
+        add(BOOST_TEST_CASE(&testChronoTimeoutsSynch));
+        add(BOOST_TEST_CASE(&testSameThreadSynch));
+        add(BOOST_TEST_CASE(&testPumpingWaitSynch));
+        add(BOOST_TEST_CASE(&testDeadlockDetectionSynch));
+        add(BOOST_TEST_CASE(&testTimeoutRaceSynch));
 
         // Asynchronous test cases
         add(BOOST_TEST_CASE(&testAbortAsynch));
         add(BOOST_TEST_CASE(&testParametersAsynch));
         add(BOOST_TEST_CASE(&testReturnValuesAsynch));
         add(BOOST_TEST_CASE(&testExceptionsAsynch));
+        add(BOOST_TEST_CASE(&testManyProducersAsynch));
+        add(BOOST_TEST_CASE(&testEndpointAsynch));
+        add(BOOST_TEST_CASE(&testTakeAsynch));
+        add(BOOST_TEST_CASE(&testVariadicAsynch));
+        add(BOOST_TEST_CASE(&testBatchAsynch));
+        add(BOOST_TEST_CASE(&testPickupBudgetAsynch));
+        add(BOOST_TEST_CASE(&testPriorityAsynch));
+        add(BOOST_TEST_CASE(&testDeadlinesAsynch));
+        add(BOOST_TEST_CASE(&testCoalescedAsynch));
+        add(BOOST_TEST_CASE(&testBoundedQueueAsynch));
+#ifndef _WIN32
+        add(BOOST_TEST_CASE(&testEventFdPickupAsynch));
+#endif
+        add(BOOST_TEST_CASE(&testManualPumpAsynch));
+        add(BOOST_TEST_CASE(&testBusyPollAsynch));
+        add(BOOST_TEST_CASE(&testAsioPickupAsynch));
+        add(BOOST_TEST_CASE(&testSchedulingFailureAsynch));
+#ifndef _WIN32
+        add(BOOST_TEST_CASE(&testThreadIdReuseAsynch));
+#endif
+
+        // Internal structures
+        add(BOOST_TEST_CASE(&testThreadRegistry));
+        add(BOOST_TEST_CASE(&testCompletionEvent));
+        add(BOOST_TEST_CASE(&testFramePool));
+        add(BOOST_TEST_CASE(&testUniqueFunction));
+        add(BOOST_TEST_CASE(&testAdaptiveSpin));
     }
 
     ~ThreadSynchTestSuite()
     {
-        SetEvent(g_hCloseEvent);
-        WaitForSingleObject(g_hTestThread, INFINITE);
-        CloseHandle(g_hTestThread);
-        CloseHandle(g_hCloseEvent);
+        stopTestThread();
 
         // Delete the singleton, for the sake of leak detection.
         // Some globals will however be detected either way, so don't be alarmed by the notification for the time being.
         // The key point is: The leak doesn't grow.
-        delete ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
+        delete ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+        delete ThreadSynch::CallScheduler<ThreadSynch::ManualPickupPolicy>::getInstance();
+        delete ThreadSynch::CallScheduler<ThreadSynch::BusyPollPickupPolicy>::getInstance();
+        delete ThreadSynch::CallScheduler<ThreadSynch::AsioPickupPolicy>::getInstance();
+        delete ThreadSynch::CallScheduler<FailingPickupPolicy>::getInstance();
+#ifndef _WIN32
+        delete ThreadSynch::CallScheduler<ThreadSynch::EventFdPickupPolicy>::getInstance();
+#endif
     }
 };
 
@@ -137,7 +286,7 @@ test_suite* init_unit_test_suite(int argc, char * argv[])
 
 void testParametersSynch()
 {
-	ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
+	ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
 
 	int input1 = 0x42;
 	boost::function<int()> callback1 = boost::bind(crossThreadIntValue, input1);
@@ -159,7 +308,7 @@ void testParametersSynch()
 
 void testReturnValuesSynch()
 {
-	ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
+	ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
 
 	boost::function<boost::shared_ptr<SharedClass>()> callback1 = crossThreadPtr;
 	boost::shared_ptr<SharedClass> ptr = scheduler->syncCall(g_dwThreadId, callback1, INFINITE);
@@ -182,19 +331,325 @@ void testExceptionsSynch()
 
 void testAbortSynch()
 {
-    ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
-    SetEvent(g_hTemporarilySuspendEvent);
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    suspendTestThread();
     Sleep(100);
     BOOST_CHECK_THROW(scheduler->syncCall<void>(g_dwThreadId, aborted, 100), ThreadSynch::CallTimeoutException);
 }
 
+/************************************************************************
+** Synchronous Suite, Test 5: Moved and move-only return values
+*/
+
+void testMovedReturnValuesSynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // The result is moved from the target thread's return statement to the caller, without copies
+    CopyCountedPayload::copies = 0;
+    boost::function<CopyCountedPayload()> callback1 = crossThreadPayload;
+    CopyCountedPayload payload = scheduler->syncCall(g_dwThreadId, callback1, INFINITE);
+    BOOST_CHECK(payload.data.size() == 1024);
+    BOOST_CHECK(CopyCountedPayload::copies == 0);
+
+    boost::function<std::unique_ptr<int>()> callback2 = boost::bind(crossThreadUniquePtr, 0x42);
+    std::unique_ptr<int> pValue = scheduler->syncCall(g_dwThreadId, callback2, INFINITE);
+    BOOST_CHECK(pValue && *pValue == 0x42);
+}
+
+/************************************************************************
+** Synchronous Suite, Test 6: Callables with forwarded arguments
+*/
+
+void testVariadicSynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // Functions and lambdas, with the return type deduced
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, crossThreadIntValue, 0x21) == 0x42);
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, [](int a, int b) { return a + b; }, 0x40, 2) == 0x42);
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, 1000, crossThreadIntValue, 0x21) == 0x42);
+
+    bool bCalled = false;
+    scheduler->syncCall(g_dwThreadId, [&bCalled]() { bCalled = true; });
+    BOOST_CHECK(bCalled);
+
+    // References are passed with std::ref
+    int input = 0x21;
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, crossThreadIntRef, std::ref(input)) == 0x42);
+
+    // Rvalue arguments are moved into the frame, and on into the call
+    CopyCountedPayload::copies = 0;
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, [](CopyCountedPayload payload) { return payload.size(); }, CopyCountedPayload()) == 1024);
+    BOOST_CHECK(CopyCountedPayload::copies == 0);
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, [](std::unique_ptr<int> pValue) { return *pValue; }, std::unique_ptr<int>(new int(0x42))) == 0x42);
+
+    // Pointers to member functions take the object as their first argument
+    CopyCountedPayload payload;
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, &CopyCountedPayload::size, &payload) == 1024);
+
+    // A bind expression ignores any arguments, so a trailing number is its timeout rather than an argument.
+    // The worker only pumps its calls after the timeouts.
+    typedef ThreadSynch::CallScheduler<ThreadSynch::ManualPickupPolicy> ManualScheduler;
+    ManualScheduler* manualScheduler = ManualScheduler::getInstance();
+    std::atomic<ThreadSynch::ThreadId> dwWorkerThreadId(0);
+    std::atomic<bool> bWorkerDone(false);
+    std::thread worker([manualScheduler, &dwWorkerThreadId, &bWorkerDone]()
+    {
+        dwWorkerThreadId = ThreadSynch::details::getCurrentThreadId();
+        Sleep(1000);
+        while(!bWorkerDone)
+        {
+            manualScheduler->pump(10, 10);
+        }
+    });
+    while(dwWorkerThreadId == 0)
+    {
+        std::this_thread::yield();
+    }
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, boost::bind(crossThreadIntValue, 0x21), 1000) == 0x42);
+    BOOST_CHECK_THROW(manualScheduler->syncCall(dwWorkerThreadId.load(), boost::bind(crossThreadIntValue, 1), 50), ThreadSynch::CallTimeoutException);
+    BOOST_CHECK_THROW(manualScheduler->syncCall<ExceptionTypes<TestException>>(dwWorkerThreadId.load(), std::bind(crossThreadIntValue, 1), 50),
+                      ThreadSynch::CallTimeoutException);
+    bWorkerDone = true;
+    worker.join();
+
+    // Exceptions are rethrown as the expected type they were caught as
+    BOOST_CHECK_EXCEPTION(makeThrowingVariadicCall(), TestException, isRealException);
+}
+
+/************************************************************************
+** Synchronous Suite, Test 7: Timeouts as std::chrono durations
+*/
+
+void testChronoTimeoutsSynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(g_dwThreadId);
+
+    BOOST_CHECK(scheduler->syncCall(endpoint, std::chrono::milliseconds(1000), crossThreadIntValue, 0x21) == 0x42);
+    std::chrono::microseconds timeout(500000);
+    BOOST_CHECK(scheduler->syncCall<ExceptionTypes<TestException>>(endpoint, timeout, crossThreadIntValue, 0x21) == 0x42);
+
+    // A call which isn't picked up in time is abandoned, at the precision of the clock rather than of milliseconds
+    std::atomic<bool> bStarted(false);
+    std::atomic<bool> bReleased(false);
+    ThreadSynch::Future<void> blocked = scheduler->asyncCall(endpoint, [&bStarted, &bReleased]() 
+    { 
+        bStarted = true;
+        while(!bReleased) 
+        {
+            std::this_thread::yield(); 
+        }
+    });
+    while(!bStarted)
+    {
+        std::this_thread::yield();
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BOOST_CHECK_THROW(scheduler->syncCall(endpoint, std::chrono::microseconds(1500), crossThreadIntValue, 0), ThreadSynch::CallTimeoutException);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::microseconds(1500));
+    bReleased = true;
+    blocked.wait(INFINITE);
+}
+
+/************************************************************************
+** Synchronous Suite, Test 8: Calls to the calling thread
+*/
+
+void testSameThreadSynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // Calls to the calling thread run inline, without a pickup, so even a thread which never picks up calls can make them
+    ThreadSynch::ThreadId dwCurrentThreadId = ThreadSynch::details::getCurrentThreadId();
+    BOOST_CHECK(scheduler->syncCall(dwCurrentThreadId, 100, crossThreadIntValue, 0x21) == 0x42);
+    BOOST_CHECK(scheduler->syncCall<int>(dwCurrentThreadId, boost::function<int()>(boost::bind(crossThreadIntValue, 0x21)), 100) == 0x42);
+    BOOST_CHECK(*scheduler->syncCall(dwCurrentThreadId, [](std::unique_ptr<int> pValue) { return pValue; }, std::unique_ptr<int>(new int(0x42))) == 0x42);
+
+    // Exceptions come back as they would from another thread
+    BOOST_CHECK_EXCEPTION(scheduler->syncCall<ExceptionTypes<TestException>>(dwCurrentThreadId, crossThreadException), TestException, isRealException);
+    BOOST_CHECK_THROW(scheduler->syncCall(dwCurrentThreadId, crossThreadException), ThreadSynch::UnexpectedException);
+
+    // A call made to the target thread, which calls back into the same thread, no longer waits for itself
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, [scheduler]() 
+    { 
+        return scheduler->syncCall(g_dwThreadId, 100, crossThreadIntValue, 0x21); 
+    }) == 0x42);
+}
+
+/************************************************************************
+** Synchronous Suite, Test 9: Pumping waits
+*/
+
+void testPumpingWaitSynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // The test thread calls back into this thread, while this thread waits for it
+    ThreadSynch::ThreadId dwCurrentThreadId = ThreadSynch::details::getCurrentThreadId();
+    registerCallingThread();
+    scheduler->setPumpingWaits(dwCurrentThreadId, TRUE);
+    auto callBack = [scheduler, dwCurrentThreadId]() -> int
+    {
+        try
+        {
+            return scheduler->syncCall(dwCurrentThreadId, 250, crossThreadIntValue, 0x21);
+        }
+        catch(ThreadSynch::CallTimeoutException&)
+        {
+            return 0;
+        }
+    };
+
+    // Both syncCall and Future::wait run the call while they wait
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, callBack) == 0x42);
+    ThreadSynch::Future<int> future = scheduler->asyncCall(g_dwThreadId, callBack);
+    BOOST_CHECK(future.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(future.getValue() == 0x42);
+
+    // Calls made without pumping block, so the call back times out
+    ThreadSynch::ThreadEndpoint blocking = scheduler->getEndpoint(g_dwThreadId).withoutPumping();
+    BOOST_CHECK(scheduler->syncCall(blocking, callBack) == 0);
+
+    scheduler->setPumpingWaits(dwCurrentThreadId, FALSE);
+    unregisterCallingThread();
+}
+
+/************************************************************************
+** Synchronous Suite, Test 10: Deadlock detection
+*/
+
+void testDeadlockDetectionSynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // The test thread calls back into this thread, while this thread is blocked on it
+    ThreadSynch::ThreadId dwCurrentThreadId = ThreadSynch::details::getCurrentThreadId();
+    registerCallingThread();
+    auto callBack = [scheduler, dwCurrentThreadId](DWORD dwTimeout) -> int
+    {
+        try
+        {
+            return scheduler->syncCall(dwCurrentThreadId, dwTimeout, crossThreadIntValue, 0x21);
+        }
+        catch(ThreadSynch::CallDeadlockException&)
+        {
+            return 1;
+        }
+        catch(ThreadSynch::CallTimeoutException&)
+        {
+            return 2;
+        }
+    };
+
+    // The cycle is found right away, rather than after the timeout
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BOOST_CHECK(scheduler->syncCall(g_dwThreadId, callBack, 5000) == 1);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+    // Waiting for a Future isn't tracked, and neither is a syncCall once it has returned
+    ThreadSynch::Future<int> future = scheduler->asyncCall(g_dwThreadId, callBack, 100);
+    future.wait(INFINITE);
+    BOOST_CHECK(future.getValue() == 2);
+
+    // Without detection, the call back waits for its timeout
+    ThreadSynch::ThreadEndpoint undetected = scheduler->getEndpoint(g_dwThreadId).withoutDeadlockDetection();
+    BOOST_CHECK(scheduler->syncCall(undetected, callBack, 100) == 2);
+
+    unregisterCallingThread();
+
+    // A caller which never registered, and never had a call scheduled to it, is tracked all the same
+    std::atomic<int> result(0);
+    std::thread caller([scheduler, &result]()
+    {
+        ThreadSynch::ThreadId dwCallerThreadId = ThreadSynch::details::getCurrentThreadId();
+        auto callBackUnregistered = [scheduler, dwCallerThreadId]() -> int
+        {
+            try
+            {
+                return scheduler->syncCall(dwCallerThreadId, 5000, crossThreadIntValue, 0x21);
+            }
+            catch(ThreadSynch::CallDeadlockException&)
+            {
+                return 1;
+            }
+            catch(ThreadSynch::CallSchedulingFailedException&)
+            {
+                return 3;
+            }
+        };
+        result = scheduler->syncCall(g_dwThreadId, callBackUnregistered);
+    });
+    start = std::chrono::steady_clock::now();
+    caller.join();
+    BOOST_CHECK(result == 1);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+}
+
+/************************************************************************
+** Synchronous Suite, Test 11: Timeouts racing the pickup
+*/
+
+void testTimeoutRaceSynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // Several threads queue calls with timeouts about as long as a pickup takes, so that the target thread
+    // claims calls while their callers cancel them, and calls behind them in the mailbox
+    const int threadCount = 4;
+    const int callsPerThread = 200;
+    std::vector<std::atomic<int>> runs(threadCount * callsPerThread);
+    std::vector<int> outcomes(threadCount * callsPerThread, 0);
+    std::vector<std::thread> callers;
+    for(int t = 0; t < threadCount; ++t)
+    {
+        callers.push_back(std::thread([scheduler, t, &runs, &outcomes]()
+        {
+            for(int i = t * callsPerThread; i < (t + 1) * callsPerThread; ++i)
+            {
+                std::atomic<int>* pRuns = &runs[i];
+                try
+                {
+                    int result = scheduler->syncCall(g_dwThreadId, std::chrono::microseconds((i % 10) * 5), [pRuns, i]() -> int
+                    {
+                        return ++*pRuns == 1 ? i * 2 : -1;
+                    });
+                    outcomes[i] = result == i * 2 ? 1 : 3;
+                }
+                catch(ThreadSynch::CallTimeoutException&)
+                {
+                    outcomes[i] = 2;
+                }
+            }
+        }));
+    }
+    for(size_t t = 0; t < callers.size(); ++t)
+    {
+        callers[t].join();
+    }
+
+    // Once the test thread has dealt with everything queued before, a call which returned its result ran
+    // exactly once, and one which timed out never ran
+    scheduler->syncCall(g_dwThreadId, crossThreadIntValue, 0);
+    int mismatches = 0;
+    for(size_t i = 0; i < outcomes.size(); ++i)
+    {
+        if(outcomes[i] != (runs[i] == 0 ? 2 : 1) || runs[i] > 1)
+        {
+            ++mismatches;
+        }
+    }
+    BOOST_CHECK(mismatches == 0);
+}
+
 /************************************************************************
 ** Asynchronous Suite, Test 1: Parameters
 */
 
 void testParametersAsynch()
 {
-    ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
 
     int input1 = 0x42;
     boost::function<int()> callback1 = boost::bind(crossThreadIntValue, input1);
@@ -222,7 +677,7 @@ void testParametersAsynch()
 
 void testReturnValuesAsynch()
 {
-    ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
     boost::function<boost::shared_ptr<SharedClass>()> callback1 = crossThreadPtr;
     ThreadSynch::Future<boost::shared_ptr<SharedClass>> f_ptr = scheduler->asyncCall(g_dwThreadId, callback1);
     f_ptr.wait(INFINITE);
@@ -235,7 +690,7 @@ void testReturnValuesAsynch()
 
 void testExceptionsAsynch()
 {
-    ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
     
     // Test with base exception listed first
     ThreadSynch::Future<void> f = scheduler->asyncCall<void, ExceptionTypes<TestException, TestDerivedException>>(g_dwThreadId, crossThreadException);
@@ -254,87 +709,1261 @@ void testExceptionsAsynch()
 
 void testAbortAsynch()
 {
-    ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
-    SetEvent(g_hTemporarilySuspendEvent);
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    suspendTestThread();
     Sleep(50);
     ThreadSynch::Future<void> f = scheduler->asyncCall<void>(g_dwThreadId, aborted);
     f.wait(100);
+
+    // An aborted call releases its bound parameters right away, rather than when the target thread gets around to it
+    boost::shared_ptr<SharedClass> pShared(new SharedClass());
+    ThreadSynch::Future<int> f2 = scheduler->asyncCall(g_dwThreadId, boost::function<int()>(boost::bind(abortedWithArgument, pShared)));
+    BOOST_CHECK(pShared.use_count() > 1);
+    BOOST_CHECK(f2.abort() == ThreadSynch::ASYNCH_CALL_ABORTED);
+    BOOST_CHECK(pShared.use_count() == 1);
+
     // abort by letting the Future-object fall out of scope
 }
 
 /************************************************************************
-** Test helper structs and functions
+** Asynchronous Suite, Test 5: Many concurrent producers
 */
 
-DWORD WINAPI testThread(PVOID)
+void testManyProducersAsynch()
 {
-    HANDLE handles[] = {g_hCloseEvent, g_hTemporarilySuspendEvent};
-    DWORD dwWaitResult;
-    while((dwWaitResult = WaitForMultipleObjectsEx(2, handles, FALSE, INFINITE, TRUE)) != WAIT_OBJECT_0)
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    const int producerCount = 16;
+    const int callsPerProducer = 200;
+
+    // Only touched by the test thread, through recordOrderedCall
+    std::vector<int> lastSeen(producerCount, -1);
+    std::atomic<int> outOfOrder(0);
+
+    std::vector<std::thread> producers;
+    for(int producer = 0; producer < producerCount; ++producer)
     {
-        if(dwWaitResult == WAIT_OBJECT_0 + 1)
+        producers.push_back(std::thread([&, producer]()
         {
-            // The thread was signaled to sleep for a few seconds
-            BOOST_MESSAGE("Worker thread sleeping a few seconds ...");
-            Sleep(3000);
-            BOOST_MESSAGE("Worker thread resuming");
-        }
-        else
-        {
-            // The thread was woken from an error or more likely an alertable event
-            Sleep(1);
-        }
+            std::vector<ThreadSynch::Future<void>> futures;
+            futures.reserve(callsPerProducer);
+            for(int sequence = 0; sequence < callsPerProducer; ++sequence)
+            {
+                futures.push_back(scheduler->asyncCall<void>(g_dwThreadId, boost::bind(recordOrderedCall, boost::ref(lastSeen), boost::ref(outOfOrder), producer, sequence)));
+            }
+            for(size_t i = 0; i < futures.size(); ++i)
+            {
+                futures[i].wait(INFINITE);
+            }
+        }));
+    }
+    for(size_t i = 0; i < producers.size(); ++i)
+    {
+        producers[i].join();
     }
-    return 0;
-}
 
-void makeThrowingCrossCall_BaseDerived()
-{
-    ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
-    // Base exception listed first
-    scheduler->syncCall<void, ExceptionTypes<TestException, TestDerivedException>>(g_dwThreadId, crossThreadException, INFINITE);
+    // Every call ran, and calls from any one producer ran in the order they were scheduled
+    BOOST_CHECK(outOfOrder == 0);
+    for(int producer = 0; producer < producerCount; ++producer)
+    {
+        BOOST_CHECK(lastSeen[producer] == callsPerProducer - 1);
+    }
 }
 
-void makeThrowingCrossCall_DerivedBase()
-{
-    ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>* scheduler = ThreadSynch::CallScheduler<ThreadSynch::APCPickupPolicy>::getInstance();
-    // Derived exception listed first
-    scheduler->syncCall<void, ExceptionTypes<TestDerivedException, TestException>>(g_dwThreadId, crossThreadException, INFINITE);
-}
+/************************************************************************
+** Asynchronous Suite, Test 6: Calls through a resolved endpoint
+*/
 
-int crossThreadIntValue(int input)
+void testEndpointAsynch()
 {
-    return input * 2;
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(g_dwThreadId);
+    BOOST_CHECK(endpoint.isResolved());
+    BOOST_CHECK(endpoint.getThreadId() == g_dwThreadId);
+
+    int input = 0x42;
+    boost::function<int()> callback = boost::bind(crossThreadIntValue, input);
+    BOOST_CHECK(scheduler->syncCall<int>(endpoint, callback, INFINITE) == callback());
+
+    std::vector<ThreadSynch::Future<int>> futures;
+    for(int i = 0; i < 100; ++i)
+    {
+        futures.push_back(scheduler->asyncCall(endpoint, boost::function<int()>(boost::bind(crossThreadIntValue, i))));
+    }
+    for(int i = 0; i < 100; ++i)
+    {
+        futures[i].wait(INFINITE);
+        BOOST_CHECK(futures[i].getValue() == crossThreadIntValue(i));
+    }
+
+    // An unresolved endpoint is looked up on every call, just like a thread id
+    ThreadSynch::ThreadEndpoint unresolved(g_dwThreadId);
+    BOOST_CHECK(!unresolved.isResolved());
+    BOOST_CHECK(scheduler->syncCall<int>(unresolved, callback, INFINITE) == callback());
 }
 
-int crossThreadIntPtr(int* input)
+/************************************************************************
+** Asynchronous Suite, Test 7: Taking values out of a Future
+*/
+
+void testTakeAsynch()
 {
-    return *input * 2;
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    boost::function<CopyCountedPayload()> callback1 = crossThreadPayload;
+    ThreadSynch::Future<CopyCountedPayload> f1 = scheduler->asyncCall(g_dwThreadId, callback1);
+    f1.wait(INFINITE);
+
+    // getValue copies, take moves, and the value can only be taken once
+    CopyCountedPayload::copies = 0;
+    BOOST_CHECK(f1.getValue().data.size() == 1024);
+    BOOST_CHECK(CopyCountedPayload::copies == 1);
+    CopyCountedPayload payload = f1.take();
+    BOOST_CHECK(payload.data.size() == 1024);
+    BOOST_CHECK(CopyCountedPayload::copies == 1);
+    BOOST_CHECK_THROW(f1.take(), ThreadSynch::FutureValueTaken);
+    BOOST_CHECK_THROW(f1.getValue(), ThreadSynch::FutureValueTaken);
+
+    boost::function<std::unique_ptr<int>()> callback2 = boost::bind(crossThreadUniquePtr, 0x42);
+    ThreadSynch::Future<std::unique_ptr<int>> f2 = scheduler->asyncCall(g_dwThreadId, callback2);
+    BOOST_CHECK(f2.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    std::unique_ptr<int> pValue = f2.take();
+    BOOST_CHECK(pValue && *pValue == 0x42);
 }
 
-int crossThreadIntRef(int& input)
+/************************************************************************
+** Asynchronous Suite, Test 8: Callables with forwarded arguments
+*/
+
+void testVariadicAsynch()
 {
-    return input * 2;
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    ThreadSynch::Future<int> f1 = scheduler->asyncCall(g_dwThreadId, [](int a) { return a * 2; }, 0x21);
+    f1.wait(INFINITE);
+    BOOST_CHECK(f1.getValue() == 0x42);
+
+    ThreadSynch::Future<std::unique_ptr<int>> f2 = scheduler->asyncCall(g_dwThreadId, crossThreadUniquePtr, 0x42);
+    f2.wait(INFINITE);
+    BOOST_CHECK(*f2.take() == 0x42);
+
+    ThreadSynch::Future<void> f3 = scheduler->asyncCall<ExceptionTypes<TestException>>(g_dwThreadId, crossThreadException);
+    f3.wait(INFINITE);
+    BOOST_CHECK_EXCEPTION(f3.abort(), TestException, isRealException);
 }
 
-boost::shared_ptr<SharedClass> crossThreadPtr()
+/************************************************************************
+** Asynchronous Suite, Test 9: Batches of calls
+*/
+
+void testBatchAsynch()
 {
-    boost::shared_ptr<SharedClass> ptr(new SharedClass);
-    BOOST_CHECK(ptr->refcount == 1);
-    return ptr;
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    std::vector<boost::function<int()>> callbacks;
+    for(int i = 0; i < 100; ++i)
+    {
+        callbacks.push_back(boost::bind(crossThreadIntValue, i));
+    }
+    ThreadSynch::BatchFuture<int> f1 = scheduler->asyncCallBatch(g_dwThreadId, callbacks);
+    BOOST_CHECK(f1.size() == callbacks.size());
+    BOOST_CHECK(f1.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    for(int i = 0; i < 100; ++i)
+    {
+        BOOST_CHECK(f1.getValue(i) == crossThreadIntValue(i));
+    }
+    BOOST_CHECK(f1.take(7) == crossThreadIntValue(7));
+    BOOST_CHECK_THROW(f1.take(7), ThreadSynch::FutureValueTaken);
+    BOOST_CHECK(f1.abort() == ThreadSynch::ASYNCH_CALL_COMPLETE);
+
+    // An empty batch is complete right away
+    std::vector<boost::function<int()>> noCallbacks;
+    ThreadSynch::BatchFuture<int> f2 = scheduler->asyncCallBatch(g_dwThreadId, noCallbacks.begin(), noCallbacks.end());
+    BOOST_CHECK(f2.size() == 0);
+    BOOST_CHECK(f2.wait(0) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+
+    // Hold the target thread up, so that the batch is still queued when aborted
+    std::atomic<bool> bReleased(false);
+    ThreadSynch::Future<void> blocker = scheduler->asyncCall(g_dwThreadId, [&bReleased]() 
+    { 
+        while(!bReleased) 
+        {
+            std::this_thread::yield(); 
+        }
+    });
+    std::vector<boost::function<void()>> abortedCallbacks(10, aborted);
+    ThreadSynch::BatchFuture<void> f3 = scheduler->asyncCallBatch(g_dwThreadId, abortedCallbacks);
+    BOOST_CHECK(f3.wait(10) == ThreadSynch::ASYNCH_CALL_PENDING);
+    BOOST_CHECK(f3.abort() == ThreadSynch::ASYNCH_CALL_ABORTED);
+    BOOST_CHECK_THROW(f3.getValue(0), ThreadSynch::FutureValuePending);
+    bReleased = true;
+    blocker.wait(INFINITE);
+
+    // The first expected exception of the batch is rethrown
+    std::vector<boost::function<void()>> throwingCallbacks(3, crossThreadException);
+    ThreadSynch::BatchFuture<void> f4 = scheduler->asyncCallBatch<ExceptionTypes<TestException>>(g_dwThreadId, throwingCallbacks);
+    BOOST_CHECK(f4.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK_EXCEPTION(f4.abort(), TestException, isRealException);
 }
 
-bool isRealException(const TestException& ex)
+/************************************************************************
+** Asynchronous Suite, Test 10: Pickup budgets
+*/
+
+void testPickupBudgetAsynch()
 {
-    return ex.magicNumber == 42;
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // A pickup runs at most 4 calls, and schedules another pickup for the rest
+    scheduler->setPickupBudget(g_dwThreadId, 4, 0);
+    std::vector<int> cycles(20, -1);
+    std::vector<boost::function<void()>> callbacks;
+    for(size_t i = 0; i < cycles.size(); ++i)
+    {
+        callbacks.push_back(boost::bind(recordPickupCycle, boost::ref(cycles), i));
+    }
+    BOOST_CHECK(scheduler->asyncCallBatch(g_dwThreadId, callbacks).wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    for(size_t i = 1; i < cycles.size(); ++i)
+    {
+        BOOST_CHECK(cycles[i] >= cycles[i - 1]);
+    }
+#ifndef _WIN32
+    // Win32 delivers APCs queued during a pickup in the same wait, so the cycles are only counted here
+    BOOST_CHECK(cycles.back() - cycles.front() >= 4);
+#endif
+
+    // A pickup stops running calls once it has spent its time
+    scheduler->setPickupBudget(g_dwThreadId, 0, 1000);
+    std::vector<int> timedCycles(5, -1);
+    std::vector<boost::function<void()>> timedCallbacks;
+    for(size_t i = 0; i < timedCycles.size(); ++i)
+    {
+        timedCallbacks.push_back([&timedCycles, i]() { Sleep(2); recordPickupCycle(timedCycles, i); });
+    }
+    BOOST_CHECK(scheduler->asyncCallBatch(g_dwThreadId, timedCallbacks).wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+#ifndef _WIN32
+    BOOST_CHECK(timedCycles.back() - timedCycles.front() >= 4);
+#endif
+
+    scheduler->setPickupBudget(g_dwThreadId, 0, 0);
 }
 
-void crossThreadException()
+/************************************************************************
+** Asynchronous Suite, Test 11: Priority lanes
+*/
+
+void testPriorityAsynch()
 {
-    throw TestDerivedException(42);
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(g_dwThreadId);
+    BOOST_CHECK(endpoint.getPriority() == ThreadSynch::CALL_PRIORITY_NORMAL);
+    BOOST_CHECK(endpoint.withPriority(ThreadSynch::CALL_PRIORITY_LOW).getPriority() == ThreadSynch::CALL_PRIORITY_LOW);
+
+    // Only touched by the test thread, until all calls have completed
+    std::vector<int> order;
+    std::atomic<bool> bStarted(false);
+    std::atomic<bool> bReleased(false);
+    std::vector<ThreadSynch::Future<void>> futures;
+
+    // Hold the target thread up while the calls are queued, so they're all picked up together
+    futures.push_back(scheduler->asyncCall(endpoint, [&bStarted, &bReleased]() 
+    { 
+        bStarted = true;
+        while(!bReleased) 
+        {
+            std::this_thread::yield(); 
+        }
+    }));
+    while(!bStarted)
+    {
+        std::this_thread::yield();
+    }
+    const int lowCount = 10;
+    const int normalCount = THREADSYNCH_PRIORITY_AGING + 10;
+    for(int i = 0; i < lowCount; ++i)
+    {
+        futures.push_back(scheduler->asyncCall(endpoint.withPriority(ThreadSynch::CALL_PRIORITY_LOW), [&order, i]() { order.push_back(2000 + i); }));
+    }
+    for(int i = 0; i < normalCount; ++i)
+    {
+        futures.push_back(scheduler->asyncCall(endpoint, [&order, i]() { order.push_back(1000 + i); }));
+    }
+    futures.push_back(scheduler->asyncCall(ThreadSynch::ThreadEndpoint(g_dwThreadId, ThreadSynch::CALL_PRIORITY_HIGH), [&order]() { order.push_back(0); }));
+    bReleased = true;
+    for(size_t i = 0; i < futures.size(); ++i)
+    {
+        futures[i].wait(INFINITE);
+    }
+
+    // The high priority call overtakes everything. Low priority calls wait for normal ones, until they
+    // have been passed over THREADSYNCH_PRIORITY_AGING times, and then get a turn.
+    BOOST_REQUIRE(order.size() == static_cast<size_t>(1 + lowCount + normalCount));
+    BOOST_CHECK(order[0] == 0);
+    for(int i = 1; i < THREADSYNCH_PRIORITY_AGING; ++i)
+    {
+        BOOST_CHECK(order[i] == 1000 + i - 1);
+    }
+    BOOST_CHECK(order[THREADSYNCH_PRIORITY_AGING] == 2000);
+
+    // Within a lane, calls keep their order
+    int lastNormal = 0;
+    int lastLow = 0;
+    for(size_t i = 1; i < order.size(); ++i)
+    {
+        int& last = order[i] >= 2000 ? lastLow : lastNormal;
+        BOOST_CHECK(order[i] > last);
+        last = order[i];
+    }
 }
 
-void aborted()
+/************************************************************************
+** Asynchronous Suite, Test 12: Deadlines
+*/
+
+void testDeadlinesAsynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(g_dwThreadId);
+    BOOST_CHECK(endpoint.getDeadline() == INFINITE);
+    BOOST_CHECK(endpoint.withDeadline(100).getDeadline() == 100);
+
+    // Only touched by the test thread, until all calls have completed
+    std::vector<int> order;
+    std::atomic<bool> bStarted(false);
+    std::atomic<bool> bReleased(false);
+    std::vector<ThreadSynch::Future<void>> futures;
+
+    // Hold the target thread up while the calls are queued
+    futures.push_back(scheduler->asyncCall(endpoint, [&bStarted, &bReleased]() 
+    { 
+        bStarted = true;
+        while(!bReleased) 
+        {
+            std::this_thread::yield(); 
+        }
+    }));
+    while(!bStarted)
+    {
+        std::this_thread::yield();
+    }
+
+    // A call which is still queued past its deadline is discarded by the target thread
+    ThreadSynch::Future<void> expired = scheduler->asyncCall(endpoint.withDeadline(10), aborted);
+
+    // The rest run earliest deadline first, and calls without a deadline last
+    scheduler->setDeadlineOrdering(endpoint, TRUE);
+    futures.push_back(scheduler->asyncCall(endpoint, [&order]() { order.push_back(0); }));
+    futures.push_back(scheduler->asyncCall(endpoint.withDeadline(5000), [&order]() { order.push_back(5000); }));
+    futures.push_back(scheduler->asyncCall(endpoint.withDeadline(3000), [&order]() { order.push_back(3000); }));
+    futures.push_back(scheduler->asyncCall(endpoint.withDeadline(4000), [&order]() { order.push_back(4000); }));
+    Sleep(50);
+    bReleased = true;
+
+    BOOST_CHECK(expired.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_ABORTED);
+    for(size_t i = 0; i < futures.size(); ++i)
+    {
+        BOOST_CHECK(futures[i].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    }
+    BOOST_REQUIRE(order.size() == 4);
+    BOOST_CHECK(order[0] == 3000);
+    BOOST_CHECK(order[1] == 4000);
+    BOOST_CHECK(order[2] == 5000);
+    BOOST_CHECK(order[3] == 0);
+    scheduler->setDeadlineOrdering(endpoint, FALSE);
+
+    // A syncCall's timeout is its deadline, which a call picked up in time doesn't notice
+    BOOST_CHECK(scheduler->syncCall(endpoint, 1000, crossThreadIntValue, 0x21) == 0x42);
+}
+
+/************************************************************************
+** Asynchronous Suite, Test 13: Coalesced calls
+*/
+
+void testCoalescedAsynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(g_dwThreadId);
+
+    // Only touched by the test thread, until all calls have completed
+    std::vector<int> order;
+    std::atomic<bool> bStarted(false);
+    std::atomic<bool> bReleased(false);
+
+    // Hold the target thread up in a coalesced call of its own, which is running, and so can't be replaced
+    ThreadSynch::Future<void> running = scheduler->asyncCallCoalesced(endpoint, 1, [&bStarted, &bReleased]() 
+    { 
+        bStarted = true;
+        while(!bReleased) 
+        {
+            std::this_thread::yield(); 
+        }
+    });
+    while(!bStarted)
+    {
+        std::this_thread::yield();
+    }
+
+    // The first call with each key takes a place in the queue, later calls with the key replace each other
+    std::vector<ThreadSynch::Future<int>> firstKey;
+    std::vector<ThreadSynch::Future<int>> secondKey;
+    for(int i = 0; i < 5; ++i)
+    {
+        firstKey.push_back(scheduler->asyncCallCoalesced(endpoint, 1, [&order](int value) { order.push_back(value); return value; }, 100 + i));
+    }
+    ThreadSynch::Future<void> plain = scheduler->asyncCall(endpoint, [&order]() { order.push_back(0); });
+    for(int i = 0; i < 3; ++i)
+    {
+        secondKey.push_back(scheduler->asyncCallCoalesced(endpoint, 2, [&order](int value) { order.push_back(value); return value; }, 200 + i));
+    }
+    bReleased = true;
+
+    BOOST_CHECK(running.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(firstKey.back().wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(firstKey.back().getValue() == 104);
+    BOOST_CHECK(secondKey.back().wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(secondKey.back().getValue() == 202);
+    BOOST_CHECK(plain.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    for(size_t i = 0; i + 1 < firstKey.size(); ++i)
+    {
+        BOOST_CHECK(firstKey[i].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_SUPERSEDED);
+    }
+    for(size_t i = 0; i + 1 < secondKey.size(); ++i)
+    {
+        BOOST_CHECK(secondKey[i].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_SUPERSEDED);
+    }
+
+    // Only the latest call with each key ran, in the place of the first
+    BOOST_REQUIRE(order.size() == 3);
+    BOOST_CHECK(order[0] == 104);
+    BOOST_CHECK(order[1] == 0);
+    BOOST_CHECK(order[2] == 202);
+
+    // Once the key's call has been picked up, the next call with the key takes a new place
+    ThreadSynch::Future<int> next = scheduler->asyncCallCoalesced(endpoint, 1, [](int value) { return value; }, 7);
+    BOOST_CHECK(next.wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(next.getValue() == 7);
+}
+
+/************************************************************************
+** Asynchronous Suite, Test 14: Bounded queues
+*/
+
+void testBoundedQueueAsynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(g_dwThreadId);
+    std::atomic<bool> bStarted(false);
+    std::atomic<bool> bReleased(false);
+    auto blocker = [&bStarted, &bReleased]() 
+    { 
+        bStarted = true;
+        while(!bReleased) 
+        {
+            std::this_thread::yield(); 
+        }
+    };
+    auto block = [&]()
+    {
+        bStarted = false;
+        bReleased = false;
+        ThreadSynch::Future<void> future = scheduler->asyncCall(endpoint, blocker);
+        while(!bStarted)
+        {
+            std::this_thread::yield();
+        }
+        return future;
+    };
+
+    // Fail fast, with watermarks
+    std::vector<BOOL> watermarks;
+    std::mutex watermarksMutex;
+    scheduler->setQueueWatermarks(endpoint, 3, 1, [&watermarks, &watermarksMutex](BOOL bAboveHighWatermark) 
+    { 
+        std::lock_guard<std::mutex> lock(watermarksMutex);
+        watermarks.push_back(bAboveHighWatermark);
+    });
+    ThreadSynch::Future<void> blocked = block();
+    scheduler->setQueueCapacity(endpoint, 4, ThreadSynch::QUEUE_FULL_FAIL, 0);
+    std::vector<ThreadSynch::Future<int>> futures;
+    for(int i = 0; i < 4; ++i)
+    {
+        futures.push_back(scheduler->asyncCall(endpoint, crossThreadIntValue, i));
+    }
+    BOOST_CHECK(scheduler->getQueueDepth(endpoint) == 4);
+    BOOST_CHECK_THROW(scheduler->asyncCall(endpoint, crossThreadIntValue, 4), ThreadSynch::CallQueueFullException);
+    BOOST_CHECK_THROW(scheduler->syncCall(endpoint, crossThreadIntValue, 4), ThreadSynch::CallSchedulingFailedException);
+    BOOST_CHECK_THROW(scheduler->asyncCallCoalesced(endpoint, 9, crossThreadIntValue, 4), ThreadSynch::CallQueueFullException);
+    {
+        std::lock_guard<std::mutex> lock(watermarksMutex);
+        BOOST_REQUIRE(watermarks.size() == 1);
+        BOOST_CHECK(watermarks[0] == TRUE);
+    }
+    bReleased = true;
+    for(size_t i = 0; i < futures.size(); ++i)
+    {
+        BOOST_CHECK(futures[i].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    }
+    blocked.wait(INFINITE);
+    BOOST_CHECK(scheduler->getQueueDepth(endpoint) == 0);
+    {
+        std::lock_guard<std::mutex> lock(watermarksMutex);
+        BOOST_REQUIRE(watermarks.size() == 2);
+        BOOST_CHECK(watermarks[1] == FALSE);
+    }
+
+    // The coalesced call which found the mailbox full gave its key's place up, rather than leave it dead
+    ThreadSynch::Future<int> coalesced = scheduler->asyncCallCoalesced(endpoint, 9, crossThreadIntValue, 5);
+    BOOST_CHECK(coalesced.wait(1000) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(coalesced.getValue() == crossThreadIntValue(5));
+    scheduler->setQueueWatermarks(endpoint, 0, 0, boost::function<void (BOOL)>());
+    futures.clear();
+
+    // Drop the oldest asynchronous call
+    ThreadSynch::Future<void> droppingBlocked = block();
+    scheduler->setQueueCapacity(endpoint, 2, ThreadSynch::QUEUE_FULL_DROP_OLDEST, 0);
+    for(int i = 0; i < 3; ++i)
+    {
+        futures.push_back(scheduler->asyncCall(endpoint, crossThreadIntValue, i));
+    }
+    BOOST_CHECK(futures[0].wait(0) == ThreadSynch::ASYNCH_CALL_DROPPED);
+    BOOST_CHECK(scheduler->getQueueDepth(endpoint) == 2);
+    bReleased = true;
+    BOOST_CHECK(futures[1].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(futures[2].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(futures[2].getValue() == crossThreadIntValue(2));
+    droppingBlocked.wait(INFINITE);
+    futures.clear();
+
+    // Block for room, first running out of time, and then until the target thread gets to its calls
+    ThreadSynch::Future<void> waitingBlocked = block();
+    scheduler->setQueueCapacity(endpoint, 1, ThreadSynch::QUEUE_FULL_BLOCK, 10);
+    futures.push_back(scheduler->asyncCall(endpoint, crossThreadIntValue, 0));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BOOST_CHECK_THROW(scheduler->asyncCall(endpoint, crossThreadIntValue, 1), ThreadSynch::CallQueueFullException);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(10));
+    scheduler->setQueueCapacity(endpoint, 1, ThreadSynch::QUEUE_FULL_BLOCK, INFINITE);
+    std::thread releaser([&bReleased]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        bReleased = true;
+    });
+    futures.push_back(scheduler->asyncCall(endpoint, crossThreadIntValue, 1));
+    releaser.join();
+    BOOST_CHECK(futures[0].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(futures[1].wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    waitingBlocked.wait(INFINITE);
+
+    scheduler->setQueueCapacity(endpoint, 0, ThreadSynch::QUEUE_FULL_BLOCK, INFINITE);
+}
+
+/************************************************************************
+** Asynchronous Suite, Test 15: Pickups through an eventfd, in an epoll loop
+*/
+
+#ifndef _WIN32
+void testEventFdPickupAsynch()
+{
+    typedef ThreadSynch::CallScheduler<ThreadSynch::EventFdPickupPolicy> EventFdScheduler;
+    EventFdScheduler* scheduler = EventFdScheduler::getInstance();
+
+    // An event loop thread, which only ever waits in epoll_wait
+    std::atomic<bool> bRegistered(false);
+    std::atomic<bool> bClose(false);
+    std::atomic<int> wakeUps(0);
+    std::atomic<ThreadSynch::ThreadId> dwLoopThreadId(0);
+    std::thread loopThread([&]()
+    {
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        int eventFd = ThreadSynch::EventFdPickupPolicy::registerCurrentThread();
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = eventFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event);
+        dwLoopThreadId = ThreadSynch::details::getCurrentThreadId();
+        bRegistered = true;
+
+        while(!bClose)
+        {
+            epoll_event ready;
+            if(epoll_wait(epollFd, &ready, 1, 10) == 1 && ThreadSynch::EventFdPickupPolicy::onReadable(scheduler))
+            {
+                ++wakeUps;
+            }
+        }
+
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, eventFd, NULL);
+        ThreadSynch::EventFdPickupPolicy::unregisterCurrentThread();
+        close(epollFd);
+    });
+    while(!bRegistered)
+    {
+        std::this_thread::yield();
+    }
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(dwLoopThreadId);
+
+    BOOST_CHECK(scheduler->syncCall(endpoint, 1000, crossThreadIntValue, 0x21) == 0x42);
+    BOOST_CHECK_EXCEPTION(scheduler->syncCall<ExceptionTypes<TestException>>(endpoint, crossThreadException), TestException, isRealException);
+
+    // Calls scheduled while the thread is busy write to the eventfd once, and are run in one wake-up
+    std::atomic<bool> bStarted(false);
+    std::atomic<bool> bReleased(false);
+    ThreadSynch::Future<void> blocked = scheduler->asyncCall(endpoint, [&bStarted, &bReleased]() 
+    { 
+        bStarted = true;
+        while(!bReleased) 
+        {
+            std::this_thread::yield(); 
+        }
+    });
+    while(!bStarted)
+    {
+        std::this_thread::yield();
+    }
+    int wakeUpsBefore = wakeUps;
+    ThreadSynch::Future<int> f1 = scheduler->asyncCall(endpoint, crossThreadIntValue, 1);
+    ThreadSynch::Future<int> f2 = scheduler->asyncCall(endpoint, crossThreadIntValue, 2);
+    ThreadSynch::Future<int> f3 = scheduler->asyncCall(endpoint, crossThreadIntValue, 3);
+    bReleased = true;
+    BOOST_CHECK(f3.wait(1000) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(f1.wait(0) == ThreadSynch::ASYNCH_CALL_COMPLETE && f1.getValue() == 2);
+    BOOST_CHECK(f2.wait(0) == ThreadSynch::ASYNCH_CALL_COMPLETE && f2.getValue() == 4);
+    BOOST_CHECK(f3.getValue() == 6);
+    BOOST_CHECK(wakeUps - wakeUpsBefore <= 2);
+
+    bClose = true;
+    loopThread.join();
+
+    // Once unregistered, the thread can no longer be targeted
+    BOOST_CHECK_THROW(scheduler->syncCall(endpoint, 100, crossThreadIntValue, 0x21), ThreadSynch::CallSchedulingFailedException);
+}
+#endif
+
+/************************************************************************
+** Asynchronous Suite, Test 16: Pumping calls by hand
+*/
+
+void testManualPumpAsynch()
+{
+    typedef ThreadSynch::CallScheduler<ThreadSynch::ManualPickupPolicy> ManualScheduler;
+    ManualScheduler* scheduler = ManualScheduler::getInstance();
+
+    // Calls wait in the mailbox until the thread pumps them, at most maxCalls at a time
+    ThreadSynch::ThreadId dwCurrentThreadId = ThreadSynch::details::getCurrentThreadId();
+    ThreadSynch::Future<int> f1 = scheduler->asyncCall(dwCurrentThreadId, crossThreadIntValue, 1);
+    ThreadSynch::Future<int> f2 = scheduler->asyncCall(dwCurrentThreadId, crossThreadIntValue, 2);
+    ThreadSynch::Future<int> f3 = scheduler->asyncCall(dwCurrentThreadId, crossThreadIntValue, 3);
+    BOOST_CHECK(f1.wait(0) == ThreadSynch::ASYNCH_CALL_PENDING);
+    BOOST_CHECK(scheduler->pump(0, 2) == 2);
+    BOOST_CHECK(f1.getValue() == 2 && f2.getValue() == 4);
+    BOOST_CHECK(f3.wait(0) == ThreadSynch::ASYNCH_CALL_PENDING);
+    BOOST_CHECK(scheduler->pump(0, 0) == 1);
+    BOOST_CHECK(f3.getValue() == 6);
+
+    // Without calls, the pump returns once the timeout has passed
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BOOST_CHECK(scheduler->pump(std::chrono::milliseconds(20), 0) == 0);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+    // A worker parked in the pump is woken by the call, rather than by its timeout
+    std::atomic<bool> bClose(false);
+    std::atomic<ThreadSynch::ThreadId> dwWorkerThreadId(0);
+    std::thread workerThread([&]()
+    {
+        dwWorkerThreadId = ThreadSynch::details::getCurrentThreadId();
+        while(!bClose)
+        {
+            scheduler->pump(INFINITE, 0);
+        }
+    });
+    while(dwWorkerThreadId == 0)
+    {
+        std::this_thread::yield();
+    }
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(dwWorkerThreadId);
+    for(int i = 0; i < 100; ++i)
+    {
+        BOOST_CHECK(scheduler->syncCall(endpoint, 1000, crossThreadIntValue, i) == i * 2);
+    }
+    BOOST_CHECK_EXCEPTION(scheduler->syncCall<ExceptionTypes<TestException>>(endpoint, crossThreadException), TestException, isRealException);
+
+    scheduler->syncCall(endpoint, [&bClose]() { bClose = true; });
+    workerThread.join();
+}
+
+/************************************************************************
+** Asynchronous Suite, Test 17: Busy polling
+*/
+
+void testBusyPollAsynch()
+{
+    typedef ThreadSynch::CallScheduler<ThreadSynch::BusyPollPickupPolicy> PollingScheduler;
+    PollingScheduler* scheduler = PollingScheduler::getInstance();
+
+    // A poll runs what has been scheduled, and never waits
+    ThreadSynch::ThreadId dwCurrentThreadId = ThreadSynch::details::getCurrentThreadId();
+    BOOST_CHECK(scheduler->poll(0) == 0);
+    ThreadSynch::Future<int> f1 = scheduler->asyncCall(dwCurrentThreadId, crossThreadIntValue, 1);
+    ThreadSynch::Future<int> f2 = scheduler->asyncCall(dwCurrentThreadId, crossThreadIntValue, 2);
+    BOOST_CHECK(scheduler->poll(1) == 1);
+    BOOST_CHECK(f1.getValue() == 2);
+    BOOST_CHECK(scheduler->poll(0) == 1);
+    BOOST_CHECK(f2.getValue() == 4);
+    BOOST_CHECK(scheduler->poll(0) == 0);
+
+    // A polling thread, which yields now and then, so that the test runs on a single core too
+    std::atomic<bool> bStop(false);
+    std::atomic<ThreadSynch::ThreadId> dwPollingThreadId(0);
+    std::thread pollingThread([&]()
+    {
+        dwPollingThreadId = ThreadSynch::details::getCurrentThreadId();
+        ThreadSynch::BusyPollPickupPolicy::run(scheduler, bStop, 64);
+    });
+    while(dwPollingThreadId == 0)
+    {
+        std::this_thread::yield();
+    }
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(dwPollingThreadId);
+    for(int i = 0; i < 100; ++i)
+    {
+        BOOST_CHECK(scheduler->syncCall(endpoint, 1000, crossThreadIntValue, i) == i * 2);
+    }
+    BOOST_CHECK_EXCEPTION(scheduler->syncCall<ExceptionTypes<TestException>>(endpoint, crossThreadException), TestException, isRealException);
+
+    bStop = true;
+    pollingThread.join();
+}
+
+/************************************************************************
+** Asynchronous Suite, Test 18: Calls into a Boost.Asio io_context
+*/
+
+void testAsioPickupAsynch()
+{
+    typedef ThreadSynch::CallScheduler<ThreadSynch::AsioPickupPolicy> AsioScheduler;
+    AsioScheduler* scheduler = AsioScheduler::getInstance();
+
+    // An io_context run by two threads. The target's calls still run one at a time.
+    boost::asio::io_context ioContext;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work(ioContext.get_executor());
+    std::thread runner1([&ioContext]() { ioContext.run(); });
+    std::thread runner2([&ioContext]() { ioContext.run(); });
+    ThreadSynch::ThreadId dwTargetId = ThreadSynch::AsioPickupPolicy::registerTarget(ioContext);
+    ThreadSynch::ThreadEndpoint endpoint = scheduler->getEndpoint(dwTargetId);
+
+    BOOST_CHECK(scheduler->syncCall(endpoint, 1000, crossThreadIntValue, 0x21) == 0x42);
+    BOOST_CHECK_EXCEPTION(scheduler->syncCall<ExceptionTypes<TestException>>(endpoint, crossThreadException), TestException, isRealException);
+    BOOST_CHECK_THROW(scheduler->syncCall(endpoint, crossThreadException), ThreadSynch::UnexpectedException);
+
+    std::atomic<int> running(0);
+    std::atomic<int> overlaps(0);
+    std::vector<ThreadSynch::Future<int>> futures;
+    for(int i = 0; i < 200; ++i)
+    {
+        futures.push_back(scheduler->asyncCall(endpoint, [&running, &overlaps](int input)
+        {
+            if(++running != 1)
+            {
+                ++overlaps;
+            }
+            std::this_thread::yield();
+            --running;
+            return input * 2;
+        }, i));
+    }
+    int mismatches = 0;
+    for(size_t i = 0; i < futures.size(); ++i)
+    {
+        if(futures[i].wait(1000) != ThreadSynch::ASYNCH_CALL_COMPLETE || futures[i].getValue() != static_cast<int>(i) * 2)
+        {
+            ++mismatches;
+        }
+    }
+    BOOST_CHECK(mismatches == 0);
+    BOOST_CHECK(overlaps == 0);
+
+    // An unregistered target can no longer be called
+    ThreadSynch::AsioPickupPolicy::unregisterTarget(dwTargetId);
+    BOOST_CHECK_THROW(scheduler->syncCall(endpoint, 100, crossThreadIntValue, 0x21), ThreadSynch::CallSchedulingFailedException);
+
+    work.reset();
+    runner1.join();
+    runner2.join();
+}
+
+/************************************************************************
+** Asynchronous Suite, Test 19: Calls to a thread which can't be sent pickups
+*/
+
+void testSchedulingFailureAsynch()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+
+    // No thread has this id, so every call must fail, not just the one which first finds the mailbox empty
+    ThreadSynch::ThreadId dwBogusThreadId = static_cast<ThreadSynch::ThreadId>(-2);
+    BOOST_CHECK_THROW(scheduler->asyncCall(dwBogusThreadId, crossThreadIntValue, 1), ThreadSynch::CallSchedulingFailedException);
+    BOOST_CHECK_THROW(scheduler->asyncCall(dwBogusThreadId, crossThreadIntValue, 2), ThreadSynch::CallSchedulingFailedException);
+    BOOST_CHECK_THROW(scheduler->syncCall(dwBogusThreadId, 100, crossThreadIntValue, 3), ThreadSynch::CallSchedulingFailedException);
+    BOOST_CHECK(scheduler->getQueueDepth(dwBogusThreadId) == 0);
+
+    // A failed notification only takes back the calls it was made for. A call which another producer pushed
+    // meanwhile stays queued, and runs once a later call gets the thread notified.
+    typedef ThreadSynch::CallScheduler<FailingPickupPolicy> FailingScheduler;
+    FailingScheduler* failingScheduler = FailingScheduler::getInstance();
+    std::unique_ptr<ThreadSynch::Future<int>> pInterleaved;
+    FailingPickupPolicy::beforeFailure = [failingScheduler, &pInterleaved]()
+    {
+        pInterleaved.reset(new ThreadSynch::Future<int>(failingScheduler->asyncCall(g_dwThreadId, crossThreadIntValue, 4)));
+    };
+    BOOST_CHECK_THROW(failingScheduler->asyncCall(g_dwThreadId, crossThreadIntValue, 5), ThreadSynch::CallSchedulingFailedException);
+    BOOST_CHECK(failingScheduler->getQueueDepth(g_dwThreadId) == 1);
+    BOOST_CHECK(failingScheduler->syncCall(g_dwThreadId, crossThreadIntValue, 6) == 12);
+    BOOST_CHECK(pInterleaved->wait(INFINITE) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(pInterleaved->getValue() == 8);
+}
+
+/************************************************************************
+** Asynchronous Suite, Test 20: A thread which gets the id of an exited thread
+*/
+
+#ifndef _WIN32
+void testThreadIdReuseAsynch()
+{
+    typedef ThreadSynch::CallScheduler<ThreadSynch::EventFdPickupPolicy> EventFdScheduler;
+    EventFdScheduler* scheduler = EventFdScheduler::getInstance();
+    ThreadSynch::ThreadId dwThreadId = ThreadSynch::details::getCurrentThreadId();
+
+    // A thread which exits with a call queued, and its pickup pending, leaves both behind in its mailbox
+    ThreadSynch::EventFdPickupPolicy::registerCurrentThread();
+    scheduler->registerCurrentThread();
+    ThreadSynch::Future<int> stale = scheduler->asyncCall(dwThreadId, crossThreadIntValue, 1);
+    ThreadSynch::EventFdPickupPolicy::unregisterCurrentThread();
+
+    // The next thread with the id starts with a clean mailbox, which notifies it of its first call
+    ThreadSynch::EventFdPickupPolicy::registerCurrentThread();
+    scheduler->registerCurrentThread();
+    BOOST_CHECK(stale.wait(0) == ThreadSynch::ASYNCH_CALL_ABORTED);
+    BOOST_CHECK(scheduler->getQueueDepth(dwThreadId) == 0);
+    ThreadSynch::Future<int> fresh = scheduler->asyncCall(dwThreadId, crossThreadIntValue, 2);
+    BOOST_CHECK(ThreadSynch::EventFdPickupPolicy::onReadable(scheduler) == TRUE);
+    BOOST_CHECK(fresh.wait(0) == ThreadSynch::ASYNCH_CALL_COMPLETE);
+    BOOST_CHECK(fresh.getValue() == crossThreadIntValue(2));
+
+    // A thread which unregisters on its way out leaves nothing behind
+    ThreadSynch::Future<int> leftOver = scheduler->asyncCall(dwThreadId, crossThreadIntValue, 3);
+    scheduler->unregisterCurrentThread();
+    ThreadSynch::EventFdPickupPolicy::unregisterCurrentThread();
+    BOOST_CHECK(leftOver.wait(0) == ThreadSynch::ASYNCH_CALL_ABORTED);
+    BOOST_CHECK(scheduler->getQueueDepth(dwThreadId) == 0);
+}
+#endif
+
+/************************************************************************
+** Internals Suite, Test 1: Thread registry growth under concurrent inserts
+*/
+
+void testThreadRegistry()
+{
+    ThreadSynch::details::ThreadRegistry<int> registry;
+
+    // Enough ids to make every shard grow several times over
+    const int threadCount = 4;
+    const int idsPerThread = 2000;
+
+    std::vector<std::thread> inserters;
+    std::atomic<int> mismatches(0);
+    for(int t = 0; t < threadCount; ++t)
+    {
+        inserters.push_back(std::thread([&, t]()
+        {
+            for(int i = 1; i <= idsPerThread; ++i)
+            {
+                // Half the ids are shared between the inserting threads
+                ThreadSynch::ThreadId id = static_cast<ThreadSynch::ThreadId>(i % 2 == 0 ? i : i + t * idsPerThread * 2);
+                if(registry.findOrCreate(id) != registry.find(id))
+                {
+                    ++mismatches;
+                }
+            }
+        }));
+    }
+    for(size_t i = 0; i < inserters.size(); ++i)
+    {
+        inserters[i].join();
+    }
+
+    BOOST_CHECK(mismatches == 0);
+    BOOST_CHECK(registry.find(2) != NULL);
+    BOOST_CHECK(registry.find(2) == registry.findOrCreate(2));
+    BOOST_CHECK(registry.find(static_cast<ThreadSynch::ThreadId>(idsPerThread * 100)) == NULL);
+}
+
+/************************************************************************
+** Internals Suite, Test 2: Completion event timeouts and wakeups
+*/
+
+void testCompletionEvent()
+{
+    ThreadSynch::details::CompletionEvent event;
+    BOOST_CHECK(!event.isSet());
+    BOOST_CHECK(!event.wait(0));
+    BOOST_CHECK(!event.wait(20));
+
+    // Every parked waiter is released by a single set
+    const int waiterCount = 8;
+    std::atomic<int> released(0);
+    std::vector<std::thread> waiters;
+    for(int i = 0; i < waiterCount; ++i)
+    {
+        waiters.push_back(std::thread([&]()
+        {
+            if(event.wait(INFINITE))
+            {
+                ++released;
+            }
+        }));
+    }
+    Sleep(50);
+    BOOST_CHECK(released == 0);
+    event.set();
+    for(size_t i = 0; i < waiters.size(); ++i)
+    {
+        waiters[i].join();
+    }
+
+    BOOST_CHECK(released == waiterCount);
+    BOOST_CHECK(event.isSet());
+    BOOST_CHECK(event.wait(0));
+}
+
+/************************************************************************
+** Internals Suite, Test 3: Frame pool recycling across threads
+*/
+
+void testFramePool()
+{
+    typedef ThreadSynch::details::FramePool FramePool;
+
+    // Blocks of the biggest size class, which the frames of the other tests are too small to share
+    const size_t size = THREADSYNCH_FRAME_POOL_CLASSES * THREADSYNCH_CACHE_LINE_SIZE - FramePool::ALIGNMENT;
+    void* pBlock = FramePool::allocate(size);
+    BOOST_CHECK(reinterpret_cast<ULONG_PTR>(pBlock) % FramePool::ALIGNMENT == 0);
+
+    // A block freed on the allocating thread is handed out again
+    FramePool::deallocate(pBlock);
+    BOOST_CHECK(FramePool::allocate(size) == pBlock);
+
+    // So is a block freed on another thread, once the owner reclaims it
+    std::thread([pBlock]() { FramePool::deallocate(pBlock); }).join();
+    BOOST_CHECK(FramePool::allocate(size) == pBlock);
+    FramePool::deallocate(pBlock);
+
+    // Blocks larger than the biggest size class bypass the pool
+    void* pLargeBlock = FramePool::allocate(THREADSYNCH_FRAME_POOL_CLASSES * THREADSYNCH_CACHE_LINE_SIZE);
+    BOOST_CHECK(pLargeBlock != NULL);
+    FramePool::deallocate(pLargeBlock);
+
+    // A pool outlives its thread, until the last of its blocks is freed
+    void* pOrphanedBlock = NULL;
+    std::thread([&pOrphanedBlock]() { pOrphanedBlock = FramePool::allocate(100); }).join();
+    FramePool::deallocate(pOrphanedBlock);
+}
+
+/************************************************************************
+** Internals Suite, Test 4: Move-only function storage and release
+*/
+
+struct MoveOnlyCallable
+{
+    explicit MoveOnlyCallable(int value) : pValue(new int(value)) {}
+    MoveOnlyCallable(MoveOnlyCallable&& other) : pValue(std::move(other.pValue)) {}
+    int operator()(int addend) const { return *pValue + addend; }
+    std::unique_ptr<int> pValue;
+};
+
+struct OversizedCallable
+{
+    explicit OversizedCallable(boost::shared_ptr<int> pValue) : pValue(pValue) {}
+    int operator()(int addend) const { return *pValue + addend; }
+    boost::shared_ptr<int> pValue;
+    char padding[THREADSYNCH_FUNCTION_BUFFER_SIZE] = {};
+};
+
+void testUniqueFunction()
+{
+    typedef ThreadSynch::details::UniqueFunction<int(int)> FunctionType;
+
+    FunctionType empty;
+    BOOST_CHECK(empty.empty());
+    BOOST_CHECK_THROW(empty(0), boost::bad_function_call);
+
+    // Targets which can't be copied are moved into place
+    FunctionType inlineFunction(MoveOnlyCallable(40));
+    BOOST_CHECK(inlineFunction(2) == 42);
+    FunctionType movedFunction(std::move(inlineFunction));
+    BOOST_CHECK(inlineFunction.empty());
+    BOOST_CHECK(movedFunction(2) == 42);
+
+    // Targets too large for the inline buffer are kept on the heap, and released on clear
+    boost::shared_ptr<int> pShared(new int(10));
+    FunctionType heapFunction((OversizedCallable(pShared)));
+    BOOST_CHECK(heapFunction(1) == 11);
+    movedFunction.swap(heapFunction);
+    BOOST_CHECK(movedFunction(1) == 11);
+    BOOST_CHECK(heapFunction(1) == 41);
+    BOOST_CHECK(pShared.use_count() == 2);
+    movedFunction = FunctionType();
+    BOOST_CHECK(pShared.use_count() == 1);
+}
+
+/************************************************************************
+** Internals Suite, Test 5: Spin tuning and spinning waits
+*/
+
+void testAdaptiveSpin()
+{
+    // Until a call has been timed, callers spin for the maximum
+    ThreadSynch::details::AdaptiveSpin spin;
+    BOOST_CHECK(spin.getSpin() == std::chrono::microseconds(THREADSYNCH_MAX_SPIN_MICROSECONDS));
+
+    // Short calls are spun on for twice their average duration
+    for(int i = 0; i < 32; ++i)
+    {
+        spin.record(std::chrono::microseconds(5));
+    }
+    BOOST_CHECK(spin.getSpin() == std::chrono::microseconds(10));
+
+    // Calls which outlast the maximum aren't spun on, and a few calls are enough to tell
+    for(int i = 0; i < 32; ++i)
+    {
+        spin.record(std::chrono::milliseconds(1));
+    }
+    BOOST_CHECK(spin.getSpin() == std::chrono::steady_clock::duration::zero());
+    for(int i = 0; i < 64; ++i)
+    {
+        spin.record(std::chrono::microseconds(5));
+    }
+    BOOST_CHECK(spin.getSpin() > std::chrono::steady_clock::duration::zero());
+    BOOST_CHECK(spin.getSpin() < std::chrono::microseconds(11));
+
+    // A spinning wait times out at the precision of the clock, and sees an event set while it parks
+    ThreadSynch::details::CompletionEvent event;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BOOST_CHECK(!event.wait(std::chrono::microseconds(300), std::chrono::microseconds(100)));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::microseconds(300));
+    std::thread setter([&event]()
+    {
+        Sleep(5);
+        event.set();
+    });
+    BOOST_CHECK(event.wait(std::chrono::steady_clock::duration::max(), std::chrono::microseconds(50)));
+    setter.join();
+}
+
+/************************************************************************
+** Test helper structs and functions
+*/
+
+#ifdef _WIN32
+DWORD WINAPI testThread(PVOID)
+{
+    HANDLE handles[] = {g_hCloseEvent, g_hTemporarilySuspendEvent};
+    DWORD dwWaitResult;
+    while((dwWaitResult = WaitForMultipleObjectsEx(2, handles, FALSE, INFINITE, TRUE)) != WAIT_OBJECT_0)
+    {
+        if(dwWaitResult == WAIT_OBJECT_0 + 1)
+        {
+            // The thread was signaled to sleep for a few seconds
+            BOOST_TEST_MESSAGE("Worker thread sleeping a few seconds ...");
+            Sleep(3000);
+            BOOST_TEST_MESSAGE("Worker thread resuming");
+        }
+        else
+        {
+            // The thread was woken from an error or more likely an alertable event
+            Sleep(1);
+        }
+    }
+    return 0;
+}
+
+void startTestThread()
+{
+    g_hCloseEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_hTemporarilySuspendEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    DWORD dwThreadId;
+    g_hTestThread = CreateThread(NULL, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(testThread), NULL, 0, &dwThreadId);
+    g_dwThreadId = dwThreadId;
+}
+
+void stopTestThread()
+{
+    SetEvent(g_hCloseEvent);
+    WaitForSingleObject(g_hTestThread, INFINITE);
+    CloseHandle(g_hTestThread);
+    CloseHandle(g_hCloseEvent);
+}
+
+void suspendTestThread()
+{
+    SetEvent(g_hTemporarilySuspendEvent);
+}
+
+void registerCallingThread()
+{
+    /* Any thread can be sent APCs */
+}
+
+void unregisterCallingThread()
+{
+    // Run the pickups the thread was sent, but never waited for
+    SleepEx(0, TRUE);
+}
+#else
+void testThread()
+{
+    TestPickupPolicy::registerCurrentThread();
+    g_testThreadId = ThreadSynch::details::getCurrentThreadId();
+
+    while(!g_bClose)
+    {
+        if(g_bTemporarilySuspend.exchange(false))
+        {
+            // The thread was signaled to sleep for a few seconds
+            BOOST_TEST_MESSAGE("Worker thread sleeping a few seconds ...");
+            Sleep(3000);
+            BOOST_TEST_MESSAGE("Worker thread resuming");
+        }
+        else
+        {
+            // Poll the flags every few milliseconds, picking up scheduled calls in between
+            if(TestPickupPolicy::alertableWait(10))
+            {
+                ++g_pickupCycles;
+            }
+        }
+    }
+
+    TestPickupPolicy::unregisterCurrentThread();
+}
+
+void startTestThread()
+{
+    g_testThread = std::thread(testThread);
+    while(g_testThreadId == 0)
+    {
+        std::this_thread::yield();
+    }
+    g_dwThreadId = g_testThreadId;
+}
+
+void stopTestThread()
+{
+    g_bClose = true;
+    g_testThread.join();
+}
+
+void suspendTestThread()
+{
+    g_bTemporarilySuspend = true;
+}
+
+void registerCallingThread()
+{
+    TestPickupPolicy::registerCurrentThread();
+}
+
+void unregisterCallingThread()
+{
+    // Run the pickups the thread was sent, but never waited for
+    TestPickupPolicy::alertableWait(0);
+    TestPickupPolicy::unregisterCurrentThread();
+}
+#endif
+
+void makeThrowingCrossCall_BaseDerived()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    // Base exception listed first
+    scheduler->syncCall<void, ExceptionTypes<TestException, TestDerivedException>>(g_dwThreadId, crossThreadException, INFINITE);
+}
+
+void makeThrowingCrossCall_DerivedBase()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    // Derived exception listed first
+    scheduler->syncCall<void, ExceptionTypes<TestDerivedException, TestException>>(g_dwThreadId, crossThreadException, INFINITE);
+}
+
+void makeThrowingVariadicCall()
+{
+    ThreadSynch::CallScheduler<TestPickupPolicy>* scheduler = ThreadSynch::CallScheduler<TestPickupPolicy>::getInstance();
+    scheduler->syncCall<ExceptionTypes<TestException>>(g_dwThreadId, crossThreadException);
+}
+
+int crossThreadIntValue(int input)
+{
+    return input * 2;
+}
+
+int crossThreadIntPtr(int* input)
+{
+    return *input * 2;
+}
+
+int crossThreadIntRef(int& input)
+{
+    return input * 2;
+}
+
+boost::shared_ptr<SharedClass> crossThreadPtr()
+{
+    boost::shared_ptr<SharedClass> ptr(new SharedClass);
+    BOOST_CHECK(ptr->refcount == 1);
+    return ptr;
+}
+
+CopyCountedPayload crossThreadPayload()
+{
+    return CopyCountedPayload();
+}
+
+std::unique_ptr<int> crossThreadUniquePtr(int input)
+{
+    return std::unique_ptr<int>(new int(input));
+}
+
+bool isRealException(const TestException& ex)
+{
+    return ex.magicNumber == 42;
+}
+
+void crossThreadException()
+{
+    throw TestDerivedException(42);
+}
+
+void aborted()
 {
     BOOST_FAIL("Aborted cross thread call was executed -- Failing hard!");
+}
+
+int abortedWithArgument(boost::shared_ptr<SharedClass> pShared)
+{
+    BOOST_FAIL("Aborted cross thread call was executed -- Failing hard!");
+    return 0;
+}
+
+void recordPickupCycle(std::vector<int>& cycles, size_t index)
+{
+    cycles[index] = g_pickupCycles;
+}
+
+void recordOrderedCall(std::vector<int>& lastSeen, std::atomic<int>& outOfOrder, int producer, int sequence)
+{
+    if(lastSeen[producer] != sequence - 1)
+    {
+        ++outOfOrder;
+    }
+    lastSeen[producer] = sequence;
 }
\ No newline at end of file